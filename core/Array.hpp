@@ -122,14 +122,17 @@ namespace p
         /**
          Offset initialisation
          */
-        Create(unsigned int dim, unsigned int* size)
+        void Create(unsigned int dim, unsigned int* size)
         {
             try
             {
+                delete[] _data;
+                delete[] _size;
+                
                 _dimension = dim;
                 _size	   = new unsigned int[_dimension];
                 _length	   = 1;
-                for (int i = 0; i < _dimension; i++)
+                for (unsigned int i = 0; i < _dimension; i++)
                 {
                     _size[i] = size[i];
                     _length *= _size[i];
@@ -144,27 +147,10 @@ namespace p
         }
         
         /**
-         Offset initialisation
+         Empty Array, to be sized with Create
          */
-        Create(unsigned int dim, unsigned int* size)
+        Array(void) : _dimension(0), _size(nullptr), _length(0), _data(nullptr)
         {
-            try
-            {
-                _dimension = dim;
-                _size	   = new unsigned int[_dimension];
-                _length	   = 1;
-                for (int i = 0; i < _dimension; i++)
-                {
-                    _size[i] = size[i];
-                    _length *= _size[i];
-                }
-                
-                _data = new T[_length];
-            }
-            catch (std::exception& e)
-            {
-                std::cout << e.what() << std::endl;
-            }
         }
         
         Array( const p::Array<T>& a) : _dimension(a._dimension), _length(a._length)
@@ -178,6 +164,17 @@ namespace p
                 _data[i] = a._data[i];
         }
         
+        Array<T>& operator=( const p::Array<T>& a)
+        {
+            if (this != &a)
+            {
+                Create(a._dimension, a._size);
+                for (unsigned int i = 0; i < _length; i++)
+                    _data[i] = a._data[i];
+            }
+            return *this;
+        }
+        
         /**
          Free dynamically allocated memory
          */
@@ -264,7 +261,7 @@ namespace p
         /**
          returns the size of the i-th dimension
          */
-        unsigned int size(unsigned int i)
+        unsigned int size(unsigned int i) const
         {
             unsigned int s;
             if (i >= _dimension)
@@ -278,7 +275,7 @@ namespace p
         /**
          returns the number of elements in the Array
          */
-        unsigned int length(void)
+        unsigned int length(void) const
         {
             return _length;
         }
@@ -286,11 +283,24 @@ namespace p
         /**
          returns the dimension of the Array
          */
-        unsigned int dimension(void)
+        unsigned int dimension(void) const
         {
             return _dimension;
         }
         
+        /**
+         returns the flattened data
+         */
+        T* data(void)
+        {
+            return _data;
+        }
+        
+        const T* data(void) const
+        {
+            return _data;
+        }
+        
         /*
          clears the content of the Array
          */
@@ -298,8 +308,10 @@ namespace p
         {
             _dimension = 0;
             delete[] _size;
+            _size = nullptr;
             _length = 0;
             delete[] _data;
+            _data = nullptr;
         }
         
         /*
@@ -0,0 +1,461 @@
+#ifndef __asyncpipeline__
+#define __asyncpipeline__
+
+#if !defined(__cpp_impl_coroutine) || !__has_include(<coroutine>)
+#error "AsyncPipeline.hpp needs C++20 coroutines: compile with -std=c++20"
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if defined(PLIB_IO_URING) && __has_include(<liburing.h>)
+#include <liburing.h>
+#define PLIB_ASYNC_IO_URING
+#endif
+
+#include "Pipeline.hpp"
+
+/************************************* Plib async pipeline ******************************************************
+Pipeline stages written as C++20 coroutines, for I/O bound sources: a stage waiting on a read does not hold
+a thread, so a few workers keep many sources and CPU bound stages busy.
+
+class Load : public p::AsyncPipeline<std::string, std::string>
+{
+	p::AsyncTask<std::string> ExecuteAsync(std::vector<std::string>::iterator begin, std::vector<std::string>::iterator end)
+	{
+		std::string content;
+		for(; begin<end; begin++) content += co_await p::AsyncIO::Instance().ReadFile(*begin);
+		co_return content;
+	}
+public:
+	Load(std::string s):AsyncPipeline(s){}
+};
+
+Reads go through io_uring when compiled with -DPLIB_IO_URING (link -luring), through a small pool of blocking
+threads otherwise. Stages resume on the executor's workers; outside of an executor (cached stages, process
+groups, GetOutput of a stage never updated) Execute waits for the coroutine on the calling thread.
+***************************************************************************************************************/
+
+namespace p
+{
+
+	// lazily started coroutine returning a T; co_await it from another coroutine
+	template <typename T>
+	class AsyncTask
+	{
+
+	public:
+
+		struct promise_type
+		{
+			T value;
+			std::exception_ptr error;
+			std::coroutine_handle<> continuation;
+
+			AsyncTask get_return_object(void) { return AsyncTask( std::coroutine_handle<promise_type>::from_promise(*this) ); }
+			std::suspend_always initial_suspend(void) noexcept { return {}; }
+			void return_value(T t) { value = std::move(t); }
+			void unhandled_exception(void) { error = std::current_exception(); }
+
+			// hands the thread over to the awaiting coroutine
+			struct FinalAwaiter
+			{
+				bool await_ready(void) noexcept { return false; }
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept
+				{
+					if( h.promise().continuation ) return h.promise().continuation;
+					return std::noop_coroutine();
+				}
+				void await_resume(void) noexcept {}
+			};
+			FinalAwaiter final_suspend(void) noexcept { return {}; }
+		};
+
+
+	private:
+
+		std::coroutine_handle<promise_type> _handle;
+
+		explicit AsyncTask(std::coroutine_handle<promise_type> h):_handle(h)
+		{}
+
+
+	public:
+
+		AsyncTask(AsyncTask&& t) noexcept : _handle( std::exchange(t._handle, nullptr) )
+		{}
+
+		AsyncTask& operator=(AsyncTask&& t) noexcept
+		{
+			if( this != &t )
+			{
+				if( _handle ) _handle.destroy();
+				_handle = std::exchange(t._handle, nullptr);
+			}
+			return *this;
+		}
+
+		~AsyncTask(void)
+		{
+			if( _handle ) _handle.destroy();
+		}
+
+		bool await_ready(void) const noexcept
+		{
+			return false;
+		}
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+		{
+			_handle.promise().continuation = awaiting;
+			return _handle;
+		}
+
+		T await_resume(void)
+		{
+			if( _handle.promise().error ) std::rethrow_exception( _handle.promise().error );
+			return std::move( _handle.promise().value );
+		}
+
+	};
+
+	// reads files without blocking the awaiting coroutine's thread
+	class AsyncIO
+	{
+
+	public:
+
+		// co_await yields the number of bytes read
+		class Read
+		{
+		private:
+			friend class AsyncIO;
+
+			int _fd;
+			void* _buffer;
+			std::size_t _size;
+			std::uint64_t _offset;
+			long _result;
+			PipelineResumer* _resumer;
+			std::coroutine_handle<> _handle;
+
+		public:
+			Read(int fd, void* buffer, std::size_t size, std::uint64_t offset)
+			:_fd(fd), _buffer(buffer), _size(size), _offset(offset), _result(0), _resumer(nullptr)
+			{}
+
+			bool await_ready(void) const noexcept
+			{
+				return _size == 0;
+			}
+
+			bool await_suspend(std::coroutine_handle<> h)
+			{
+				_handle = h;
+				_resumer = PipelineResumer::Current();
+				return AsyncIO::Instance().Submit(this);
+			}
+
+			std::size_t await_resume(void)
+			{
+				if( _result < 0 ) throw std::system_error(-_result, std::generic_category(), "async read");
+				return _result;
+			}
+		};
+
+
+	private:
+
+		pid_t _pid;
+		std::mutex _mutex;
+		std::condition_variable _wakeUp;
+		bool _stop;
+		std::vector<std::thread> _threads;
+		#ifdef PLIB_ASYNC_IO_URING
+			io_uring _ring;
+		#else
+			std::deque<Read*> _queue;
+		#endif
+
+		// threads do not survive fork: a child process reads on the awaiting thread
+		bool Forked(Read* r)
+		{
+			if( getpid() == _pid ) return false;
+			long result = pread(r->_fd, r->_buffer, r->_size, r->_offset);
+			r->_result = result < 0 ? -errno : result;
+			return true;
+		}
+
+		// the awaiting stage goes back to its executor, or resumes here when there is none
+		static void Complete(Read* r, long result)
+		{
+			r->_result = result;
+			std::coroutine_handle<> h = r->_handle;
+			if( r->_resumer ) r->_resumer->Post( [h]{ h.resume(); } );
+			else h.resume();
+		}
+
+		#ifdef PLIB_ASYNC_IO_URING
+
+		AsyncIO(void):_pid(getpid()),_stop(false)
+		{
+			int e = io_uring_queue_init(256, &_ring, 0);
+			if( e < 0 ) throw std::system_error(-e, std::generic_category(), "io_uring_queue_init");
+			_threads.emplace_back( [this]{ Reap(); } );
+		}
+
+		~AsyncIO(void)
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stop = true;
+				io_uring_sqe* sqe = io_uring_get_sqe(&_ring);
+				io_uring_prep_nop(sqe);
+				io_uring_sqe_set_data(sqe, nullptr);
+				io_uring_submit(&_ring);
+			}
+			_threads[0].join();
+			io_uring_queue_exit(&_ring);
+		}
+
+		// false if the read completed on the spot
+		bool Submit(Read* r)
+		{
+			if( Forked(r) ) return false;
+			std::lock_guard<std::mutex> lock(_mutex);
+			io_uring_sqe* sqe = io_uring_get_sqe(&_ring);
+			while( !sqe ) // submission queue full: hand over what is queued
+			{
+				io_uring_submit(&_ring);
+				sqe = io_uring_get_sqe(&_ring);
+			}
+			io_uring_prep_read(sqe, r->_fd, r->_buffer, r->_size, r->_offset);
+			io_uring_sqe_set_data(sqe, r);
+			io_uring_submit(&_ring);
+			return true;
+		}
+
+		// single completion thread
+		void Reap(void)
+		{
+			for(;;)
+			{
+				io_uring_cqe* cqe;
+				if( io_uring_wait_cqe(&_ring, &cqe) < 0 ) continue;
+				Read* r = static_cast<Read*>( io_uring_cqe_get_data(cqe) );
+				long result = cqe->res;
+				io_uring_cqe_seen(&_ring, cqe);
+
+				if( r ) Complete(r, result);
+				else
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					if( _stop ) return;
+				}
+			}
+		}
+
+		#else
+
+		AsyncIO(unsigned int threads = 4):_pid(getpid()),_stop(false)
+		{
+			for(unsigned int t=0; t<threads; t++)
+				_threads.emplace_back( [this]{ Serve(); } );
+		}
+
+		~AsyncIO(void)
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stop = true;
+			}
+			_wakeUp.notify_all();
+			for(std::thread& t : _threads) t.join();
+		}
+
+		// false if the read completed on the spot
+		bool Submit(Read* r)
+		{
+			if( Forked(r) ) return false;
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_queue.push_back(r);
+			}
+			_wakeUp.notify_one();
+			return true;
+		}
+
+		// blocking reads, away from the executor's workers
+		void Serve(void)
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			for(;;)
+			{
+				_wakeUp.wait(lock, [&]{ return _stop || !_queue.empty(); });
+				if( _queue.empty() ) return;
+
+				Read* r = _queue.front();
+				_queue.pop_front();
+				lock.unlock();
+
+				long result = pread(r->_fd, r->_buffer, r->_size, r->_offset);
+				Complete(r, result < 0 ? -errno : result);
+
+				lock.lock();
+			}
+		}
+
+		#endif
+
+
+	public:
+
+		AsyncIO(const AsyncIO&) = delete;
+		AsyncIO& operator=(const AsyncIO&) = delete;
+
+		static AsyncIO& Instance(void)
+		{
+			static AsyncIO io;
+			return io;
+		}
+
+		// whole content of a file, read by chunks of chunkSize bytes
+		AsyncTask<std::string> ReadFile(std::string path, std::size_t chunkSize = 1<<20)
+		{
+			int fd = open(path.c_str(), O_RDONLY);
+			if( fd < 0 ) throw std::system_error(errno, std::generic_category(), "cannot open '"+path+"'");
+
+			std::string content;
+			std::exception_ptr error;
+			try
+			{
+				struct stat info;
+				if( fstat(fd, &info) == 0 ) content.reserve(info.st_size);
+
+				std::vector<char> chunk(chunkSize);
+				for(;;)
+				{
+					std::size_t n = co_await Read(fd, chunk.data(), chunk.size(), content.size());
+					if( n == 0 ) break;
+					content.append(chunk.data(), n);
+				}
+			}
+			catch(...)
+			{
+				error = std::current_exception();
+			}
+
+			close(fd);
+			if( error ) std::rethrow_exception(error);
+			co_return content;
+		}
+
+	};
+
+	template <typename I, typename O>
+	class AsyncPipeline : public Pipeline<I,O>
+	{
+
+	private:
+
+		// starts on creation, frees itself once done
+		struct Detached
+		{
+			struct promise_type
+			{
+				Detached get_return_object(void) { return {}; }
+				std::suspend_never initial_suspend(void) noexcept { return {}; }
+				std::suspend_never final_suspend(void) noexcept { return {}; }
+				void return_void(void) {}
+				void unhandled_exception(void) { std::terminate(); }
+			};
+		};
+
+		static Detached Drive(AsyncPipeline* self, std::function<void(std::exception_ptr)> completed)
+		{
+			std::exception_ptr error;
+			try
+			{
+				self->_output = co_await self->ExecuteAsync( self->_input.begin(), self->_input.end() );
+				self->_isCalculated = true;
+			}
+			catch(...)
+			{
+				error = std::current_exception();
+			}
+			completed(error);
+		}
+
+
+	protected:
+
+		virtual AsyncTask<O> ExecuteAsync(typename std::vector<I>::iterator begin, typename std::vector<I>::iterator end) = 0;
+
+		// cached stages go through the synchronous path, which looks the cache up
+		bool RunAsync(std::function<void(std::exception_ptr)> completed)
+		{
+			if( this->IsCached() ) return false;
+			Drive(this, completed);
+			return true;
+		}
+
+		// waits on this thread: suspensions resume on the I/O threads instead of the executor's
+		O Execute(typename std::vector<I>::iterator begin, typename std::vector<I>::iterator end) final
+		{
+			std::mutex mutex;
+			std::condition_variable finished;
+			bool done = false;
+			O output;
+			std::exception_ptr error;
+
+			PipelineResumer* resumer = PipelineResumer::Current();
+			PipelineResumer::Current() = nullptr;
+
+			auto wait = [&]() -> Detached
+			{
+				try
+				{
+					output = co_await ExecuteAsync(begin, end);
+				}
+				catch(...)
+				{
+					error = std::current_exception();
+				}
+				std::lock_guard<std::mutex> lock(mutex);
+				done = true;
+				finished.notify_one();
+			};
+			wait();
+
+			PipelineResumer::Current() = resumer;
+			std::unique_lock<std::mutex> lock(mutex);
+			finished.wait(lock, [&]{ return done; });
+
+			if( error ) std::rethrow_exception(error);
+			return output;
+		}
+
+
+	public:
+
+		AsyncPipeline(std::string s):Pipeline<I,O>(s)
+		{}
+
+	};
+
+}
+
+#endif
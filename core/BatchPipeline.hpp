@@ -0,0 +1,90 @@
+#ifndef __batchpipeline__
+#define __batchpipeline__
+
+#include <vector>
+
+#include "Pipeline.hpp"
+#include "Span.hpp"
+#include "Thread.hpp"
+
+/************************************* Plib batch pipeline ******************************************************
+Pipeline stage processing its inputs by contiguous batches instead of one call over the whole input vector.
+
+class Sum : public p::BatchPipeline<double,double>
+{
+	std::size_t PreferredBatchSize(void) const { return 4096; }
+	bool IsStateless(void) const { return true; } // batches may run concurrently
+	double ExecuteBatch(p::Span<const double> batch) { return std::accumulate(batch.begin(), batch.end(), 0.0); }
+	double Merge(const double& a, const double& b) { return a+b; }
+public:
+	Sum(std::string s):BatchPipeline(s){}
+};
+
+Batching happens within the stage: the inputs it gathered from its upstream connections are laid out
+contiguously and cut in batches, which may thus span two connections. Stages are not batched together.
+Partial outputs are merged in input order: Merge has to be associative, not commutative.
+Stateless stages run their batches with p::parallel_for on the shared ThreadPool (Thread.hpp), so they
+still get threads while the executor runs other stages.
+***************************************************************************************************************/
+
+namespace p
+{
+
+	template <typename I, typename O>
+	class BatchPipeline : public Pipeline<I,O>
+	{
+
+	protected:
+
+		// number of input elements per ExecuteBatch call; 0 means the whole input at once
+		virtual std::size_t PreferredBatchSize(void) const
+		{
+			return 1024;
+		}
+
+		// true if ExecuteBatch touches no shared state, allowing concurrent batches
+		virtual bool IsStateless(void) const
+		{
+			return false;
+		}
+
+		virtual O ExecuteBatch(Span<const I> batch) = 0;
+		virtual O Merge(const O& accumulated, const O& partial) = 0;
+
+		O Execute(typename std::vector<I>::iterator begin, typename std::vector<I>::iterator end) final;
+
+
+	public:
+
+		BatchPipeline(std::string s):Pipeline<I,O>(s)
+		{}
+
+	};
+
+	template<class I, class O>
+	O BatchPipeline<I,O>::Execute(typename std::vector<I>::iterator begin, typename std::vector<I>::iterator end)
+	{
+		const std::size_t size = end-begin;
+		Span<const I> input( size ? &(*begin) : nullptr, size );
+
+		std::size_t batchSize = PreferredBatchSize();
+		if( batchSize == 0 || batchSize >= size ) return ExecuteBatch(input);
+
+		const long long nbBatches = (size+batchSize-1)/batchSize;
+		std::vector<O> partial(nbBatches);
+
+		if( IsStateless() )
+			parallel_for(0, nbBatches, 1, [&](std::size_t b){ partial[b] = ExecuteBatch( input.Subspan(b*batchSize, batchSize) ); });
+		else
+			for(long long b=0; b<nbBatches; b++) partial[b] = ExecuteBatch( input.Subspan(b*batchSize, batchSize) );
+
+		O output = partial[0];
+		for(long long b=1; b<nbBatches; b++)
+			output = Merge(output, partial[b]);
+
+		return output;
+	}
+
+}
+
+#endif
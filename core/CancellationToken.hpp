@@ -0,0 +1,150 @@
+#ifndef __cancellationtoken__
+#define __cancellationtoken__
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <exception>
+
+/************************************* Plib cancellation ******************************************************
+Cooperative cancellation of Pipeline runs: a token is cancelled by anyone holding a copy of it,
+and checked by the executor between stages and by the stages themselves while they run.
+
+p::CancellationToken token;
+std::thread watchdog([&]{ if( UserPressedStop() ) token.Cancel("stopped by user"); });
+executor.Run(sink, token);                                    // throws p::PipelineCancelledException once cancelled
+executor.Run(sink, p::CancellationToken::After(std::chrono::seconds(30)));
+
+// inside a long Execute, every few thousand elements
+p::CancellationToken::Current().ThrowIfCancelled();
+
+A child token is cancelled with its parent, or by itself; cancelling it does not cancel the parent.
+***************************************************************************************************************/
+
+namespace p
+{
+
+	class PipelineCancelledException : public std::exception
+	{
+	private:
+		std::string _what;
+	public:
+		PipelineCancelledException(std::string what):_what(what)
+		{}
+		virtual const char* what() const throw()
+		{
+			return _what.c_str();
+		}
+	};
+
+	class CancellationToken
+	{
+
+	public:
+
+		typedef std::chrono::steady_clock Clock;
+
+
+	private:
+
+		struct State
+		{
+			std::atomic<bool> cancelled;
+			std::mutex mutex;
+			std::string reason;
+			std::shared_ptr<State> parent;
+			bool hasDeadline;
+			Clock::time_point deadline;
+			std::string deadlineReason;
+
+			State(std::shared_ptr<State> p):cancelled(false),parent(p),hasDeadline(false)
+			{}
+		};
+
+		std::shared_ptr<State> _state;
+
+		CancellationToken(std::shared_ptr<State> state):_state(state)
+		{}
+
+
+	public:
+
+		CancellationToken(void):_state(std::make_shared<State>(nullptr))
+		{}
+
+		// cancelled once timeout has elapsed, from now
+		template<class Rep, class Period>
+		static CancellationToken After(std::chrono::duration<Rep,Period> timeout)
+		{
+			return CancellationToken().WithDeadline( Clock::now()+timeout, "timed out" );
+		}
+
+		// token of the stage running on the calling thread; a token never cancelled outside of executors
+		static CancellationToken& Current(void)
+		{
+			static thread_local CancellationToken current;
+			return current;
+		}
+
+		// cancelled with this one, or once deadline is reached
+		CancellationToken WithDeadline(Clock::time_point deadline, const std::string& reason = "deadline exceeded") const
+		{
+			CancellationToken child = Child();
+			child._state->hasDeadline = true;
+			child._state->deadline = deadline;
+			child._state->deadlineReason = reason;
+			return child;
+		}
+
+		// cancelled with this one, and cancellable on its own
+		CancellationToken Child(void) const
+		{
+			return CancellationToken( std::make_shared<State>(_state) );
+		}
+
+		// the first reason given is kept
+		void Cancel(const std::string& reason = "cancelled")
+		{
+			std::lock_guard<std::mutex> lock(_state->mutex);
+			if( _state->cancelled.load(std::memory_order_relaxed) ) return;
+			_state->reason = reason;
+			_state->cancelled.store(true, std::memory_order_release);
+		}
+
+		bool IsCancelled(void) const
+		{
+			for(const State* s = _state.get(); s; s = s->parent.get())
+			{
+				if( s->cancelled.load(std::memory_order_acquire) ) return true;
+				if( s->hasDeadline && Clock::now() >= s->deadline ) return true;
+			}
+			return false;
+		}
+
+		// why the token, or the closest of its ancestors, was cancelled; empty while it is not
+		std::string Reason(void) const
+		{
+			for(State* s = _state.get(); s; s = s->parent.get())
+			{
+				if( s->cancelled.load(std::memory_order_acquire) )
+				{
+					std::lock_guard<std::mutex> lock(s->mutex);
+					return s->reason;
+				}
+				if( s->hasDeadline && Clock::now() >= s->deadline ) return s->deadlineReason;
+			}
+			return "";
+		}
+
+		void ThrowIfCancelled(void) const
+		{
+			if( IsCancelled() ) throw PipelineCancelledException( Reason() );
+		}
+
+	};
+
+}
+
+#endif
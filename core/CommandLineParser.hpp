@@ -7,19 +7,33 @@ p::CommandLineParser parser(argc, argv);
 int input = parser.addOption<int>("-i",-17,"test int");
 std::string allo = parser.addOption<std::string>("-s","coucou","test string");
 std::string peep = parser.addOption<std::string>("-p","salut");
+bool verbose = parser.addOption<bool>("-v",false,"flag: true when given without value");
+std::vector<std::string_view> includes = parser.addRepeatedOption<std::string_view>("-I","include directory");
 parser.CompileHelpFromOptions();
 
+prog -i -5 --name=foo -I a -I b -v input.txt -- -not-an-option
+	"-i -5": negative numbers are values, not options
+	"--name=foo", "-i=3": value in the same argument
+	repeated options: the last one wins for addOption, addRepeatedOption gets them all, in order
+	"--": the arguments after it are positional (see Positional())
+
+Requires C++17. Nothing is copied out of argv: options are views into it, kept in a table sorted by name,
+and converted with std::from_chars only when asked for. Invalid values print an error and exit.
+
 */
 
+#ifndef __commandlineparser__
+#define __commandlineparser__
+
 #include <iostream>
 #include <sstream>
 #include <string>
-#include <cstring>
-#include <cstdarg>
+#include <string_view>
+#include <charconv>
 #include <cstdlib>// EXIT_SUCCESS
 #include <vector>
-#include <exception>
-#include <map>
+#include <algorithm>
+#include <type_traits>
 
 // #include "version.hpp"
 
@@ -29,104 +43,224 @@ namespace p
 	class CommandLineParser
 	{
 	private:
-		std::map<std::string, std::string> _argmap;
-		std::map<std::string, std::string> _descriptionmap;
-		bool _displayHelp;
-		std::string _appName;
 
+		struct Argument
+		{
+			std::string_view name;  // with its dashes
+			std::string_view value; // empty for flags
+			int position;           // in argv, to keep repeated options in order
+			bool separate;          // value in the next argument, not after '='
+		};
+
+		std::vector<Argument> _arguments;  // sorted by name, then position
+		std::vector<Argument> _positional; // value and position only
+		std::vector< std::pair<std::string, std::string> > _descriptions; // only filled to display the help
+		bool _displayHelp;
+		std::string_view _appName;
 
-		template <typename T>
-		T ConvertTo ( const std::string &Text )
+		// "-x", "--xy"; but "-5", "-.5" and "-" are values
+		static bool IsOption(std::string_view s)
 		{
-			std::istringstream ss(Text);
-			T result;
-			return ss >> result ? result : 0;
+			if( s.size() < 2 || s[0] != '-' ) return false;
+			return !( (s[1] >= '0' && s[1] <= '9') || s[1] == '.' );
 		}
+
 		template <typename T>
-		std::string ConvertToString ( const T &Number )
+		static std::string ConvertToString(const T& value)
 		{
 			std::ostringstream ss;
-			ss << Number;
+			ss << std::boolalpha << value;
 			return ss.str();
 		}
 
-	public:
-		CommandLineParser(int argc, char** argv)
+		template <typename T>
+		T Convert(std::string_view optName, std::string_view text) const
 		{
-			int numArg = argc;
-			std::vector<std::string> argList;
+			T result{};
+			if( !ConvertTo(text, result) )
+			{
+				std::cerr << _appName << ": invalid value '" << text << "' for " << optName << std::endl;
+				exit(EXIT_FAILURE);
+			}
+			return result;
+		}
 
-			_displayHelp = false;
-			_appName = argv[0];
+		// occurrences of optName, in command line order
+		std::pair<std::vector<Argument>::const_iterator, std::vector<Argument>::const_iterator> Find(std::string_view optName) const
+		{
+			return std::equal_range(_arguments.begin(), _arguments.end(), Argument{optName, std::string_view(), 0, false},
+				[](const Argument& a, const Argument& b){ return a.name < b.name; });
+		}
 
-			std::string key = "/";
-			std::size_t found = _appName.rfind(key);
-			if (found!=std::string::npos)
-			_appName.replace (0,found+1,"");
+		// "-v input.txt": a flag followed by a positional argument, given back
+		void GiveBackPositional(Argument& flag)
+		{
+			bool value;
+			if( !flag.separate || ConvertTo(flag.value, value) ) return;
+
+			Argument positional = { std::string_view(), flag.value, flag.position+1, false };
+			_positional.insert(std::upper_bound(_positional.begin(), _positional.end(), positional,
+				[](const Argument& a, const Argument& b){ return a.position < b.position; }), positional);
+			flag.value = std::string_view();
+			flag.separate = false;
+		}
 
+		// defaults are only printed, hence converted, when the help is displayed
+		template <typename T>
+		void Describe(std::string_view optName, const std::string& description, const T* defaultValue)
+		{
+			if( !_displayHelp ) return;
+			_descriptions.emplace_back( std::string(optName), defaultValue ? description+" [default:"+ConvertToString(*defaultValue)+"]" : description );
+		}
 
+	public:
+		// text as a T: from_chars for numbers, 1/0, true/false, yes/no, on/off (or nothing) for bools
+		template <typename T>
+		static bool ConvertTo(std::string_view text, T& result)
+		{
+			if constexpr ( std::is_same<T, bool>::value )
+			{
+				if( text.empty() || text == "1" || text == "true" || text == "yes" || text == "on" ) result = true;
+				else if( text == "0" || text == "false" || text == "no" || text == "off" ) result = false;
+				else return false;
+				return true;
+			}
+			else if constexpr ( std::is_arithmetic<T>::value )
+			{
+				if( text.size() > 1 && text[0] == '+' ) text.remove_prefix(1);
+				const char* end = text.data() + text.size();
+				std::from_chars_result r = std::from_chars(text.data(), end, result);
+				return r.ec == std::errc() && r.ptr == end;
+			}
+			else if constexpr ( std::is_constructible<T, std::string_view>::value )
+			{
+				result = T(text);
+				return true;
+			}
+			else
+			{
+				std::istringstream ss{ std::string(text) };
+				return (bool)(ss >> result);
+			}
+		}
 
-			// convert char** to vector<string>
+		CommandLineParser(int argc, char** argv)
+		:_displayHelp(false), _appName(argc > 0 ? argv[0] : "")
+		{
+			std::size_t found = _appName.rfind('/');
+			if (found!=std::string_view::npos)
+			_appName.remove_prefix(found+1);
 
+			_arguments.reserve(argc);
+			bool optionsEnded = false;
 			for (int i = 1; i < argc; i++)
 			{
-				std::stringstream ss;
-				std::string		  s;
-				ss << argv[i];
-				ss >> s;
-				argList.push_back(s);
+				std::string_view s = argv[i];
 
-				if(s=="-h" || s=="--help")
+				if( optionsEnded || !IsOption(s) )
 				{
-					_displayHelp = true;
+					_positional.push_back( Argument{std::string_view(), s, i, false} );
+					continue;
 				}
-				if(s=="--version")
+				if( s == "--" )
 				{
-					DisplayOption();
+					optionsEnded = true;
+					continue;
 				}
-			}
+				if( s == "-h" || s == "--help" ) _displayHelp = true;
+				if( s == "--version" ) DisplayOption();
 
-			// map <option , Argument>
-
-			for (unsigned int i = 0; i < argList.size(); i++)
-			{
-				if (argList[i][0] == '-')
+				// --key=value, or -k value when the next argument is not an option
+				Argument a = { s, std::string_view(), i, false };
+				std::size_t equal = s.find('=');
+				if( equal != std::string_view::npos )
 				{
-					if(i!=argList.size()-1) // argList[i + 1] exists
-					{
-						if (argList[i + 1][0] != '-')
-						_argmap.insert(std::pair<std::string, std::string>(argList[i], argList[i + 1]) );
-						else
-						_argmap.insert(std::pair<std::string, std::string>(argList[i],  "") );
-					}
-					else
-					{
-						_argmap.insert(std::pair<std::string, std::string>(argList[i],  "") );
-					}
+					a.name = s.substr(0, equal);
+					a.value = s.substr(equal+1);
 				}
+				else if( i+1 < argc && !IsOption(argv[i+1]) && std::string_view(argv[i+1]) != "--" )
+				{
+					a.value = argv[++i];
+					a.separate = true;
+				}
+				_arguments.push_back(a);
 			}
+
+			std::sort(_arguments.begin(), _arguments.end(), [](const Argument& a, const Argument& b)
+			{
+				return a.name < b.name || (a.name == b.name && a.position < b.position);
+			});
 		}
 
+		// value of the last occurrence of optName, defaultValue when absent.
+		// bool options given without value are true
 		template<typename Type>
-		Type addOption(std::string optName, Type defaultValue, std::string description = "default description")
+		Type addOption(std::string_view optName, Type defaultValue, std::string description = "default description")
 		{
-			Type result;
+			Describe(optName, description, &defaultValue);
 
-			//if option is found
+			auto range = Find(optName);
+			if( range.first == range.second ) return defaultValue;
+			Argument& last = _arguments[range.second - 1 - _arguments.begin()];
 
-			if (_argmap.find(optName) != _argmap.end() )
-			result = ConvertTo<Type>(_argmap.find(optName)->second);
+			if constexpr ( std::is_same<Type, bool>::value ) GiveBackPositional(last);
+			return Convert<Type>(optName, last.value);
+		}
 
-			//if option not found, assign default value
+		// values of every occurrence of optName, in command line order
+		template<typename Type>
+		std::vector<Type> addRepeatedOption(std::string_view optName, std::string description = "default description")
+		{
+			Describe<Type>(optName, description + " (repeatable)", nullptr);
 
-			else
-			result = defaultValue;
+			std::vector<Type> values;
+			auto range = Find(optName);
+			for(auto it = range.first; it != range.second; ++it) values.push_back( Convert<Type>(optName, it->value) );
+			return values;
+		}
 
+		// raw values of every occurrence of optName, in command line order; for options read by other means
+		std::vector<std::string_view> getValues(std::string_view optName) const
+		{
+			std::vector<std::string_view> values;
+			auto range = Find(optName);
+			for(auto it = range.first; it != range.second; ++it) values.push_back(it->value);
+			return values;
+		}
 
-			description = description+" [default:"+ConvertToString(defaultValue)+"]";
-			_descriptionmap.insert(std::pair<std::string, std::string>(optName, description) );
+		// raw values of every occurrence of the bool option optName, unconverted: "true" when given without
+		// value, and positional arguments following it given back as for addOption<bool>
+		std::vector<std::string_view> getFlagValues(std::string_view optName)
+		{
+			std::vector<std::string_view> values;
+			auto range = Find(optName);
+			for(auto it = range.first; it != range.second; ++it)
+			{
+				Argument& a = _arguments[it - _arguments.begin()];
+				GiveBackPositional(a);
+				values.push_back( a.value.empty() ? std::string_view("true") : a.value );
+			}
+			return values;
+		}
 
-			return result;
+		// lists optName in the help
+		void addDescription(std::string_view optName, const std::string& description)
+		{
+			Describe<int>(optName, description, nullptr);
+		}
+
+		bool hasOption(std::string_view optName) const
+		{
+			auto range = Find(optName);
+			return range.first != range.second;
+		}
+
+		// arguments that are neither options nor their values, in order
+		std::vector<std::string_view> Positional(void) const
+		{
+			std::vector<std::string_view> values;
+			for(const Argument& a : _positional) values.push_back(a.value);
+			return values;
 		}
 
 		// Needs to be added at the end of all addOption calls
@@ -134,14 +268,15 @@ namespace p
 		{
 			if(_displayHelp)
 			{
+				std::sort(_descriptions.begin(), _descriptions.end());
 				std::cout<<std::endl<<"Usage:"<<std::endl;
 				std::cout<<_appName<<" [options]"<<std::endl;
 				std::cout<<"Options:"<<std::endl;
-				for (auto& opt: _descriptionmap)
+				for (auto& opt: _descriptions)
 				{
 					std::cout <<"\t"<< opt.first << ":\t" << opt.second << '\n';
 				}
-				std::cout <<"\t--version:\tPrint the version number of "+_appName+" and exit.\n";
+				std::cout <<"\t--version:\tPrint the version number of "<<_appName<<" and exit.\n";
 
 				std::cout << std::endl<<s<<std::endl;
 
@@ -162,3 +297,5 @@ namespace p
 	};
 
 }
+
+#endif
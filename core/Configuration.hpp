@@ -0,0 +1,307 @@
+#ifndef __configuration__
+#define __configuration__
+
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <functional>
+#include <exception>
+#include <type_traits>
+#include <cstdlib>
+#include <cctype>
+
+#include "CommandLineParser.hpp"
+#include "Logger.hpp"
+
+/************************************* Plib configuration ******************************************************
+Settings resolved once, at startup, from layers each overriding the previous ones:
+defaults < XML file < environment variables < command line.
+
+struct Training { int epochs = 10; double rate = 0.01; bool verbose = false; std::vector<std::string> augment; };
+
+p::CommandLineParser parser(argc, argv);
+p::ConfigurationLayer file("training.xml");
+p::ConfigurationLoader().Load("training.xml", file);   // xmlreader/ConfigurationLoader.hpp
+
+const Training training = p::Configuration<Training>()
+	.Option("epochs", &Training::epochs, "passes over the data")
+	.Option("optimizer.rate", &Training::rate, "learning rate")
+	.Option("verbose", &Training::verbose)
+	.Option("augment", &Training::augment, "augmentations")  // lists: repeated elements, arguments, or a,b,c
+	.Layer(file)
+	.Environment("TRAIN_")                                    // TRAIN_EPOCHS, TRAIN_OPTIMIZER_RATE, ...
+	.CommandLine(parser)                                      // --epochs 20, --optimizer.rate=0.1, --verbose
+	.Resolve();
+parser.CompileHelpFromOptions();                              // lists the options, after Resolve
+
+Resolve fills a plain struct: hot code reads its members, without lookups or conversions.
+Layers apply in the order they are added; a layer giving a list replaces the whole list.
+Invalid values throw p::ConfigurationException, naming where they come from (file and line, variable, argument).
+Keys of a layer matching no option are logged as warnings: they are usually typos.
+***************************************************************************************************************/
+
+namespace p
+{
+
+	class ConfigurationException : public std::exception
+	{
+	private:
+		std::string _what;
+	public:
+		ConfigurationException(std::string what):_what(what)
+		{}
+		virtual const char* what() const throw()
+		{
+			return _what.c_str();
+		}
+	};
+
+	// key -> values, as read from one source; a key given several times holds a list
+	class ConfigurationLayer
+	{
+
+	public:
+
+		struct Entry
+		{
+			std::string value;
+			std::string source; // "file.xml:12", "environment TRAIN_EPOCHS", ...
+		};
+
+
+	private:
+
+		std::string _name;
+		std::map< std::string, std::vector<Entry> > _values;
+
+
+	public:
+
+		ConfigurationLayer(std::string name = "values"):_name(name)
+		{}
+
+		// appended to the key's values
+		void Add(const std::string& key, const std::string& value, const std::string& source = "")
+		{
+			_values[key].push_back( Entry{value, source.empty() ? _name : source} );
+		}
+
+		// nullptr if the layer has no value for key
+		const std::vector<Entry>* Find(const std::string& key) const
+		{
+			std::map< std::string, std::vector<Entry> >::const_iterator it = _values.find(key);
+			return it == _values.end() ? nullptr : &it->second;
+		}
+
+		const std::map< std::string, std::vector<Entry> >& Values(void) const
+		{
+			return _values;
+		}
+
+		const std::string& Name(void) const
+		{
+			return _name;
+		}
+
+	};
+
+	template <class T>
+	class Configuration
+	{
+
+	private:
+
+		typedef ConfigurationLayer::Entry Entry;
+
+		template<class V> struct IsList : std::false_type {};
+		template<class V, class A> struct IsList< std::vector<V,A> > : std::true_type {};
+
+		struct Binding
+		{
+			std::string key, description;
+			bool list, flag;
+			std::function<void(T&, const std::vector<Entry>&)> assign;
+			std::function<std::string(const T&)> show;
+		};
+
+		struct Source
+		{
+			enum Kind { VALUES, ENVIRONMENT, COMMAND_LINE } kind;
+			ConfigurationLayer values;
+			std::string prefix;
+			CommandLineParser* parser;
+		};
+
+		T _defaults;
+		std::vector<Binding> _options;
+		std::vector<Source> _layers;
+
+		template<class V>
+		static V Convert(const std::string& key, const Entry& entry)
+		{
+			V value{};
+			if( !CommandLineParser::ConvertTo(std::string_view(entry.value), value) )
+				throw ConfigurationException(entry.source+": "+key+": invalid value '"+entry.value+"'");
+			return value;
+		}
+
+		// the last value wins, for single values
+		template<class V>
+		static void Assign(V& member, const std::string& key, const std::vector<Entry>& entries)
+		{
+			member = Convert<V>(key, entries.back());
+		}
+
+		template<class V, class A>
+		static void Assign(std::vector<V,A>& member, const std::string& key, const std::vector<Entry>& entries)
+		{
+			member.clear();
+			for(const Entry& entry : entries) member.push_back( Convert<V>(key, entry) );
+		}
+
+		template<class V>
+		static std::string Show(const V& value)
+		{
+			std::ostringstream ss;
+			ss << std::boolalpha << value;
+			return ss.str();
+		}
+
+		template<class V, class A>
+		static std::string Show(const std::vector<V,A>& values)
+		{
+			std::string shown;
+			for(const V& v : values) shown += (shown.empty() ? "" : ",") + Show(v);
+			return shown;
+		}
+
+		// optimizer.rate -> PREFIX_OPTIMIZER_RATE
+		static std::string VariableName(const std::string& prefix, const std::string& key)
+		{
+			std::string name = prefix;
+			for(char c : key) name += std::isalnum((unsigned char)c) ? (char)std::toupper((unsigned char)c) : '_';
+			return name;
+		}
+
+		// values the layer gives for the option, none if it does not set it
+		static std::vector<Entry> Lookup(const Source& layer, const Binding& option, const T& defaults)
+		{
+			std::vector<Entry> entries;
+			switch( layer.kind )
+			{
+				case Source::VALUES:
+					if( const std::vector<Entry>* found = layer.values.Find(option.key) ) entries = *found;
+					break;
+
+				case Source::ENVIRONMENT:
+				{
+					std::string name = VariableName(layer.prefix, option.key);
+					const char* value = std::getenv(name.c_str());
+					if( !value ) break;
+					std::string text = value, source = "environment "+name;
+					if( !option.list ) entries.push_back( Entry{text, source} );
+					else
+					{
+						std::istringstream ss(text);
+						std::string item;
+						while( std::getline(ss, item, ',') ) entries.push_back( Entry{item, source} );
+					}
+					break;
+				}
+
+				case Source::COMMAND_LINE:
+				{
+					CommandLineParser& parser = *layer.parser;
+					std::string name = "--"+option.key, source = "argument "+name;
+					bool help = parser.hasOption("-h") || parser.hasOption("--help");
+
+					// defaults only converted to text for the help; values converted by Convert, as for the other layers
+					if( help ) parser.addDescription(name, option.description+" [default:"+option.show(defaults)+"]");
+					// flags: "--verbose", "--verbose=false", and "--verbose input.txt" leaving input.txt positional
+					for(std::string_view v : option.flag ? parser.getFlagValues(name) : parser.getValues(name))
+						entries.push_back( Entry{std::string(v), source} );
+					if( !option.list && entries.size() > 1 ) entries.erase(entries.begin(), entries.end()-1);
+					break;
+				}
+			}
+			return entries;
+		}
+
+
+	public:
+
+		Configuration(T defaults = T()):_defaults(defaults)
+		{}
+
+		// key: dotted path, as in the XML file ("optimizer.rate"); member: where Resolve stores its value
+		template<class M>
+		Configuration& Option(const std::string& key, M T::*member, const std::string& description = "")
+		{
+			Binding option;
+			option.key = key;
+			option.description = description.empty() ? key : description;
+			option.list = IsList<M>::value;
+			option.flag = std::is_same<M, bool>::value;
+			option.assign = [member, key](T& settings, const std::vector<Entry>& entries){ Assign(settings.*member, key, entries); };
+			option.show = [member](const T& settings){ return Show(settings.*member); };
+			_options.push_back(option);
+			return *this;
+		}
+
+		Configuration& Layer(const ConfigurationLayer& values)
+		{
+			_layers.push_back( Source{Source::VALUES, values, "", nullptr} );
+			return *this;
+		}
+
+		// read when resolving: PREFIX followed by the key in upper case, dots as underscores
+		Configuration& Environment(const std::string& prefix)
+		{
+			_layers.push_back( Source{Source::ENVIRONMENT, ConfigurationLayer(), prefix, nullptr} );
+			return *this;
+		}
+
+		// --key value or --key=value; the parser has to outlive the call to Resolve
+		Configuration& CommandLine(CommandLineParser& parser)
+		{
+			_layers.push_back( Source{Source::COMMAND_LINE, ConfigurationLayer(), "", &parser} );
+			return *this;
+		}
+
+		// the defaults, overridden by each layer in turn; throws ConfigurationException
+		T Resolve(void) const
+		{
+			for(const Source& layer : _layers)
+			{
+				if( layer.kind != Source::VALUES ) continue;
+				for(const auto& value : layer.values.Values())
+				{
+					bool known = false;
+					for(const Binding& option : _options) known = known || option.key == value.first;
+					if( !known )
+					{
+						PLIB_LOG_WARNING("unknown configuration key").Field("key", value.first).Field("source", value.second.front().source);
+					}
+				}
+			}
+
+			T settings = _defaults;
+			for(const Binding& option : _options)
+			{
+				std::vector<Entry> entries;
+				for(const Source& layer : _layers)
+				{
+					std::vector<Entry> found = Lookup(layer, option, _defaults);
+					if( !found.empty() ) entries.swap(found);
+				}
+				if( !entries.empty() ) option.assign(settings, entries);
+			}
+			return settings;
+		}
+
+	};
+
+}
+
+#endif
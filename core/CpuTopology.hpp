@@ -0,0 +1,197 @@
+#ifndef __cputopology__
+#define __cputopology__
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <dirent.h>
+#endif
+
+/************************************* Plib CPU topology ******************************************************
+CPUs the process may run on, grouped by NUMA node, as read from /sys/devices/system/node.
+
+const p::CpuTopology& topology = p::CpuTopology::Instance();
+for(unsigned int n=0; n<topology.Nodes(); n++)
+	std::cout << "node " << n << ": " << topology.Cpus(n).size() << " cpus";
+p::CpuTopology::PinCurrentThread( topology.Cpus(1)[0] );  // runs on that CPU only
+p::CpuTopology::PinCurrentThreadToNode(1);                // runs on any CPU of node 1
+
+Memory is placed on the node of the thread first writing it, so data initialised by a pinned worker is
+local to it (see ThreadPool::FirstTouch). Without /sys (not Linux, containers) every CPU is on node 0;
+pinning is a no-op returning false where unsupported.
+***************************************************************************************************************/
+
+namespace p
+{
+
+	class CpuTopology
+	{
+
+	private:
+
+		std::vector< std::vector<int> > _cpus; // per node, only the CPUs of the process' affinity mask
+		std::vector<int> _nodeOf;              // per CPU id, -1 if not usable
+
+		// "0-3,8,10-11"
+		static std::vector<int> ParseList(const std::string& list)
+		{
+			std::vector<int> cpus;
+			std::stringstream ss(list);
+			std::string range;
+			while( std::getline(ss, range, ',') )
+			{
+				int first, last;
+				char dash;
+				std::istringstream r(range);
+				if( !(r >> first) ) continue;
+				last = (r >> dash >> last) ? last : first;
+				for(int c=first; c<=last; c++) cpus.push_back(c);
+			}
+			return cpus;
+		}
+
+		static std::vector<int> AllowedCpus(void)
+		{
+			std::vector<int> cpus;
+			#ifdef __linux__
+				cpu_set_t set;
+				CPU_ZERO(&set);
+				if( sched_getaffinity(0, sizeof(set), &set) == 0 )
+					for(int c=0; c<CPU_SETSIZE; c++)
+						if( CPU_ISSET(c, &set) ) cpus.push_back(c);
+			#endif
+			if( cpus.empty() )
+				for(unsigned int c=0; c<std::max(1u, std::thread::hardware_concurrency()); c++) cpus.push_back(c);
+			return cpus;
+		}
+
+		CpuTopology(void)
+		{
+			std::vector<int> allowed = AllowedCpus();
+			_nodeOf.assign(allowed.back()+1, -1);
+
+			#ifdef __linux__
+				std::vector<int> nodes;
+				if( DIR* dir = opendir("/sys/devices/system/node") )
+				{
+					while( dirent* entry = readdir(dir) )
+					{
+						std::string name = entry->d_name;
+						if( name.compare(0, 4, "node") == 0 && name.size() > 4 && name.find_first_not_of("0123456789", 4) == std::string::npos )
+							nodes.push_back( std::stoi(name.substr(4)) );
+					}
+					closedir(dir);
+				}
+				std::sort(nodes.begin(), nodes.end());
+
+				for(int node : nodes)
+				{
+					std::ifstream file( "/sys/devices/system/node/node"+std::to_string(node)+"/cpulist" );
+					std::string list;
+					std::getline(file, list);
+
+					std::vector<int> cpus;
+					for(int c : ParseList(list))
+						if( std::binary_search(allowed.begin(), allowed.end(), c) ) cpus.push_back(c);
+					// nodes without CPUs, or none the process may use
+					if( cpus.empty() ) continue;
+
+					for(int c : cpus) _nodeOf[c] = _cpus.size();
+					_cpus.push_back(cpus);
+				}
+			#endif
+
+			// CPUs no node claimed
+			std::vector<int> orphans;
+			for(int c : allowed)
+				if( _nodeOf[c] < 0 ) orphans.push_back(c);
+			if( !orphans.empty() )
+			{
+				if( _cpus.empty() ) _cpus.push_back( std::vector<int>() );
+				for(int c : orphans)
+				{
+					_nodeOf[c] = 0;
+					_cpus[0].push_back(c);
+				}
+			}
+		}
+
+
+	public:
+
+		static const CpuTopology& Instance(void)
+		{
+			static CpuTopology topology;
+			return topology;
+		}
+
+		// nodes with at least one usable CPU, numbered from 0
+		unsigned int Nodes(void) const
+		{
+			return _cpus.size();
+		}
+
+		const std::vector<int>& Cpus(unsigned int node) const
+		{
+			return _cpus.at(node);
+		}
+
+		unsigned int NbCpus(void) const
+		{
+			unsigned int n = 0;
+			for(const std::vector<int>& cpus : _cpus) n += cpus.size();
+			return n;
+		}
+
+		// -1 for CPUs the process may not use
+		int NodeOf(int cpu) const
+		{
+			return cpu >= 0 && cpu < (int)_nodeOf.size() ? _nodeOf[cpu] : -1;
+		}
+
+		// CPU the calling thread is running on, -1 if unknown
+		static int CurrentCpu(void)
+		{
+			#ifdef __linux__
+				return sched_getcpu();
+			#else
+				return -1;
+			#endif
+		}
+
+		static bool PinCurrentThread(int cpu)
+		{
+			return PinCurrentThread( std::vector<int>(1, cpu) );
+		}
+
+		static bool PinCurrentThreadToNode(unsigned int node)
+		{
+			return node < Instance().Nodes() && PinCurrentThread( Instance().Cpus(node) );
+		}
+
+		// restricts the calling thread to cpus
+		static bool PinCurrentThread(const std::vector<int>& cpus)
+		{
+			#ifdef __linux__
+				cpu_set_t set;
+				CPU_ZERO(&set);
+				for(int c : cpus)
+					if( c >= 0 && c < CPU_SETSIZE ) CPU_SET(c, &set);
+				return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+			#else
+				return false;
+			#endif
+		}
+
+	};
+
+}
+
+#endif
@@ -0,0 +1,330 @@
+#ifndef __dataparallel__
+#define __dataparallel__
+
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+
+#include "Pipeline.hpp"
+#include "Thread.hpp"
+
+/************************************* Plib data parallel stages ******************************************************
+Ready made Pipeline stages over vectors, splitting their input range in chunks run by p::parallel_for on the
+shared ThreadPool (Thread.hpp).
+
+p::Map<int,double> root("root", [](const int& i){ return std::sqrt(i); });
+p::Filter<double> small("small", [](const double& d){ return d < 10; });
+p::Reduce<double> sum("sum", 0.0, [](const double& a, const double& b){ return a+b; });
+root.SetInput(numbers); small.SetInput(&root); sum.SetInput(&small);
+
+p::Partition<int> byParity("parity", 2, [](const int& i){ return std::size_t(i%2); }); // vector of buckets
+p::Join<int> all("all"); // concatenates the vectors of all its inputs
+
+The vectors received from every input are processed as one sequence, in input order; outputs keep that order.
+Reduce combines chunk results pairwise in a tree, so its operation has to be associative, not commutative.
+Functions are called concurrently and must not share state. Map to bool is not supported (std::vector<bool>).
+The pool is shared by every stage: a stage running alongside others in a PipelineExecutor still has its chunks
+split over the pool's idle workers. Cancelled stages stop at the next chunk.
+***************************************************************************************************************/
+
+namespace p
+{
+
+	template <typename I, typename O>
+	class DataParallelPipeline : public Pipeline<std::vector<I>, O>
+	{
+
+	protected:
+
+		typedef typename std::vector< std::vector<I> >::iterator Inputs;
+
+		// elements [start, start+size) of the concatenated inputs, starting at (*input)[offset]
+		struct Chunk
+		{
+			std::size_t start;
+			std::size_t size;
+			Inputs input;
+			std::size_t offset;
+		};
+
+		std::size_t _grainSize;
+
+		static std::size_t Total(Inputs begin, Inputs end)
+		{
+			std::size_t total = 0;
+			for(; begin<end; begin++) total += begin->size();
+			return total;
+		}
+
+		std::vector<Chunk> Split(Inputs begin, Inputs end) const
+		{
+			std::vector<Chunk> chunks;
+			std::size_t total = Total(begin, end);
+			std::size_t grain = std::max<std::size_t>(_grainSize, 1);
+
+			Inputs input = begin;
+			std::size_t offset = 0;
+			for(std::size_t start=0; start<total; start+=grain)
+			{
+				while( offset == input->size() ) { input++; offset = 0; }
+				chunks.push_back( Chunk{start, std::min(grain, total-start), input, offset} );
+
+				// position of the next chunk
+				std::size_t skip = grain;
+				while( input < end && skip >= input->size()-offset )
+				{
+					skip -= input->size()-offset;
+					input++;
+					offset = 0;
+				}
+				offset += skip;
+			}
+			return chunks;
+		}
+
+		// f(element, index in the concatenated inputs)
+		template<class F>
+		static void ForEach(const Chunk& chunk, F f)
+		{
+			Inputs input = chunk.input;
+			std::size_t offset = chunk.offset;
+			for(std::size_t g=chunk.start; g<chunk.start+chunk.size; g++)
+			{
+				while( offset == input->size() ) { input++; offset = 0; }
+				f( (*input)[offset++], g );
+			}
+		}
+
+		// f(k) for k in [0,n) on the shared pool and the calling thread, the first exception being rethrown.
+		// Once the stage's token is cancelled, the remaining chunks are skipped
+		template<class F>
+		static void ParallelFor(std::size_t n, F f)
+		{
+			CancellationToken token = CancellationToken::Current(); // thread local: pool workers have their own
+
+			parallel_for(0, n, 1, [&](std::size_t k)
+			{
+				token.ThrowIfCancelled();
+				f(k);
+			});
+		}
+
+
+	public:
+
+		DataParallelPipeline(std::string s, std::size_t grainSize = 4096):Pipeline<std::vector<I>, O>(s),_grainSize(grainSize)
+		{}
+
+		// elements per chunk: large enough to amortise scheduling, small enough to balance threads
+		void SetGrainSize(std::size_t grainSize)
+		{
+			_grainSize = grainSize;
+		}
+
+	};
+
+	template <typename I, typename O>
+	class Map : public DataParallelPipeline< I, std::vector<O> >
+	{
+
+	private:
+
+		typedef DataParallelPipeline< I, std::vector<O> > Base;
+		std::function<O(const I&)> _f;
+
+	protected:
+
+		std::vector<O> Execute(typename Base::Inputs begin, typename Base::Inputs end)
+		{
+			std::vector<O> output( Base::Total(begin, end) );
+			std::vector<typename Base::Chunk> chunks = this->Split(begin, end);
+
+			Base::ParallelFor(chunks.size(), [&](std::size_t k)
+			{
+				Base::ForEach(chunks[k], [&](const I& i, std::size_t g){ output[g] = _f(i); });
+			});
+			return output;
+		}
+
+	public:
+
+		Map(std::string s, std::function<O(const I&)> f):Base(s),_f(f)
+		{}
+
+	};
+
+	template <typename T>
+	class Filter : public DataParallelPipeline< T, std::vector<T> >
+	{
+
+	private:
+
+		typedef DataParallelPipeline< T, std::vector<T> > Base;
+		std::function<bool(const T&)> _keep;
+
+	protected:
+
+		std::vector<T> Execute(typename Base::Inputs begin, typename Base::Inputs end)
+		{
+			std::vector<typename Base::Chunk> chunks = this->Split(begin, end);
+			std::vector< std::vector<T> > kept(chunks.size());
+
+			Base::ParallelFor(chunks.size(), [&](std::size_t k)
+			{
+				Base::ForEach(chunks[k], [&](const T& t, std::size_t){ if( _keep(t) ) kept[k].push_back(t); });
+			});
+
+			std::vector<std::size_t> offset(chunks.size()+1, 0);
+			for(std::size_t k=0; k<chunks.size(); k++) offset[k+1] = offset[k] + kept[k].size();
+
+			std::vector<T> output(offset.back());
+			Base::ParallelFor(chunks.size(), [&](std::size_t k)
+			{
+				std::move(kept[k].begin(), kept[k].end(), output.begin()+offset[k]);
+			});
+			return output;
+		}
+
+	public:
+
+		Filter(std::string s, std::function<bool(const T&)> keep):Base(s),_keep(keep)
+		{}
+
+	};
+
+	template <typename T>
+	class Reduce : public DataParallelPipeline<T,T>
+	{
+
+	private:
+
+		typedef DataParallelPipeline<T,T> Base;
+		T _identity;
+		std::function<T(const T&, const T&)> _op;
+
+	protected:
+
+		T Execute(typename Base::Inputs begin, typename Base::Inputs end)
+		{
+			std::vector<typename Base::Chunk> chunks = this->Split(begin, end);
+			if( chunks.empty() ) return _identity;
+
+			std::vector<T> partial(chunks.size(), _identity);
+			Base::ParallelFor(chunks.size(), [&](std::size_t k)
+			{
+				Base::ForEach(chunks[k], [&](const T& t, std::size_t){ partial[k] = _op(partial[k], t); });
+			});
+
+			// pairwise tree: log2(chunks) levels, each combining neighbours concurrently
+			for(std::size_t step=1; step<partial.size(); step*=2)
+			{
+				std::size_t pairs = (partial.size()-step+2*step-1)/(2*step);
+				Base::ParallelFor(pairs, [&](std::size_t k)
+				{
+					std::size_t left = 2*step*k;
+					partial[left] = _op(partial[left], partial[left+step]);
+				});
+			}
+			return partial[0];
+		}
+
+	public:
+
+		// identity is the neutral element of op: op(identity, t) == t
+		Reduce(std::string s, T identity, std::function<T(const T&, const T&)> op):Base(s),_identity(identity),_op(op)
+		{}
+
+	};
+
+	// stable split of the elements in buckets
+	template <typename T>
+	class Partition : public DataParallelPipeline< T, std::vector< std::vector<T> > >
+	{
+
+	private:
+
+		typedef DataParallelPipeline< T, std::vector< std::vector<T> > > Base;
+		std::size_t _buckets;
+		std::function<std::size_t(const T&)> _key;
+
+	protected:
+
+		std::vector< std::vector<T> > Execute(typename Base::Inputs begin, typename Base::Inputs end)
+		{
+			std::vector<typename Base::Chunk> chunks = this->Split(begin, end);
+			std::vector<std::size_t> key( Base::Total(begin, end) );
+			std::vector< std::vector<std::size_t> > count( chunks.size(), std::vector<std::size_t>(_buckets, 0) );
+
+			Base::ParallelFor(chunks.size(), [&](std::size_t k)
+			{
+				Base::ForEach(chunks[k], [&](const T& t, std::size_t g)
+				{
+					key[g] = _key(t);
+					if( key[g] >= _buckets ) throw std::out_of_range("Partition '"+this->_name+"': key out of range");
+					count[k][key[g]]++;
+				});
+			});
+
+			// where each chunk starts writing in each bucket
+			std::vector< std::vector<T> > output(_buckets);
+			for(std::size_t b=0; b<_buckets; b++)
+			{
+				std::size_t size = 0;
+				for(std::size_t k=0; k<chunks.size(); k++)
+				{
+					std::size_t c = count[k][b];
+					count[k][b] = size;
+					size += c;
+				}
+				output[b].resize(size);
+			}
+
+			Base::ParallelFor(chunks.size(), [&](std::size_t k)
+			{
+				Base::ForEach(chunks[k], [&](const T& t, std::size_t g){ output[key[g]][count[k][key[g]]++] = t; });
+			});
+			return output;
+		}
+
+	public:
+
+		// key has to return a bucket in [0, buckets)
+		Partition(std::string s, std::size_t buckets, std::function<std::size_t(const T&)> key):Base(s),_buckets(buckets),_key(key)
+		{}
+
+	};
+
+	// fan-in: concatenation of all inputs, in input order
+	template <typename T>
+	class Join : public DataParallelPipeline< T, std::vector<T> >
+	{
+
+	private:
+
+		typedef DataParallelPipeline< T, std::vector<T> > Base;
+
+	protected:
+
+		std::vector<T> Execute(typename Base::Inputs begin, typename Base::Inputs end)
+		{
+			std::vector<T> output( Base::Total(begin, end) );
+			std::vector<typename Base::Chunk> chunks = this->Split(begin, end);
+
+			Base::ParallelFor(chunks.size(), [&](std::size_t k)
+			{
+				Base::ForEach(chunks[k], [&](const T& t, std::size_t g){ output[g] = t; });
+			});
+			return output;
+		}
+
+	public:
+
+		Join(std::string s):Base(s)
+		{}
+
+	};
+
+}
+
+#endif
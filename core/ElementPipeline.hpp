@@ -0,0 +1,125 @@
+#ifndef __elementpipeline__
+#define __elementpipeline__
+
+#include <vector>
+#include <functional>
+
+#include "Pipeline.hpp"
+
+/************************************* Plib element-wise pipeline ******************************************************
+Pipeline stage transforming its input collections one element at a time.
+
+class Normalize : public p::ElementPipeline<double,double>
+{
+	bool Apply(const double& in, double& out) { out = in/255.0; return true; }
+public:
+	Normalize(std::string s):ElementPipeline(s){}
+};
+
+class DropNegative : public p::ElementPipeline<double,double>
+{
+	bool Apply(const double& in, double& out) { out = in; return in >= 0; } // false drops the element
+public:
+	DropNegative(std::string s):ElementPipeline(s){}
+};
+
+normalize->SetInput(samples);
+dropNegative->SetInput(normalize); // vector<double> -> vector<double>
+dropNegative->Update();
+
+When an element-wise stage is the single input of another one and has no other consumer,
+the executor fuses them: the consumer pulls each element through the producer's Apply,
+and the producer's output vector is never built (GetOutput on it stays empty).
+Cached stages are never fused, since their cache key needs the materialised inputs.
+***************************************************************************************************************/
+
+namespace p
+{
+
+	template <typename O>
+	class ElementSource
+	{
+	public:
+		virtual ~ElementSource(void) {}
+
+		// gathers the stage's inputs and hands each produced element to sink, without storing them
+		virtual void ForEachElement(const std::function<void(const O&)>& sink) = 0;
+	};
+
+	template <typename I, typename O>
+	class ElementPipeline : public Pipeline< std::vector<I>, std::vector<O> >, public ElementSource<O>
+	{
+
+	private:
+
+		typedef Pipeline< std::vector<I>, std::vector<O> > Base;
+
+		ElementSource<I>* _fusedProducer;
+
+
+	protected:
+
+		// false drops the element
+		virtual bool Apply(const I& in, O& out) = 0;
+
+		// the range is never read: ForEachGathered walks the gathered inputs, or the fused producer's elements
+		std::vector<O> Execute(typename std::vector< std::vector<I> >::iterator /*begin*/, typename std::vector< std::vector<I> >::iterator /*end*/)
+		{
+			std::vector<O> output;
+			ForEachGathered( [&](const O& o){ output.push_back(o); } );
+			return output;
+		}
+
+		void GatherInputs(void)
+		{
+			if( !_fusedProducer )
+			{
+				Base::GatherInputs();
+				return;
+			}
+
+			// the producer's elements are streamed by ForEachGathered
+			this->_input.assign( this->_constantInput.begin(), this->_constantInput.end() );
+		}
+
+		void ForEachGathered(const std::function<void(const O&)>& sink)
+		{
+			O o;
+			for(const std::vector<I>& collection : this->_input)
+				for(const I& i : collection)
+					if( Apply(i, o) ) sink(o);
+
+			if( _fusedProducer )
+				_fusedProducer->ForEachElement( [&](const I& i){ if( Apply(i, o) ) sink(o); } );
+		}
+
+
+	public:
+
+		ElementPipeline(std::string s):Base(s),_fusedProducer(nullptr)
+		{}
+
+		void* ElementSourcePointer(void)
+		{
+			return static_cast< ElementSource<O>* >(this);
+		}
+
+		// producer's output type was checked to be std::vector<I> when connected
+		bool FuseProducer(PipelineNode* producer)
+		{
+			_fusedProducer = producer ? static_cast< ElementSource<I>* >( producer->ElementSourcePointer() ) : nullptr;
+			return true;
+		}
+
+		// called on a fused producer, which is not scheduled by itself
+		void ForEachElement(const std::function<void(const O&)>& sink)
+		{
+			GatherInputs();
+			ForEachGathered(sink);
+		}
+
+	};
+
+}
+
+#endif
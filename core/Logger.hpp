@@ -0,0 +1,465 @@
+#ifndef __logger__
+#define __logger__
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <sstream>
+#include <algorithm>
+#include <type_traits>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+/************************************* Plib logger ******************************************************
+Structured log records, buffered per thread without locking and written out by a background thread.
+
+p::Logger::Instance().Open("run.log");            // stderr until then
+p::Logger::Instance().SetLevel(p::Logger::DEBUG); // INFO by default
+PLIB_LOG_INFO("stage done").Field("stage", name).Field("ms", 12.5);
+
+2026-10-19T13:20:01.123456Z level=info thread=3 msg="stage done" stage="filter 1" ms=12.5
+
+Levels below PLIB_LOG_LEVEL are compiled out, arguments included: -DPLIB_LOG_LEVEL=3 keeps warnings and errors.
+Logging never blocks nor locks: a record not fitting in its thread's buffer is dropped, and the number of
+dropped records is logged at the next flush. Records are written every 50ms, right away for errors, and at exit.
+The buffer of a thread that exits is drained by the next flush, then handed to a thread logging for the first time.
+The logger is never destroyed, so threads may log and exit during static destruction; records logged after
+the final flush, run by atexit, are not written.
+fork is safe: the child finds the logger unlocked, without the parent's pending records, and without flusher
+thread; its records are written by Flush or at exit.
+***************************************************************************************************************/
+
+#ifndef PLIB_LOG_LEVEL
+#define PLIB_LOG_LEVEL 1 // DEBUG
+#endif
+
+namespace p
+{
+
+	class Logger
+	{
+
+	public:
+
+		enum Level { TRACE = 0, DEBUG = 1, INFO = 2, WARNING = 3, ERROR = 4, OFF = 5 };
+
+
+	private:
+
+		// single producer (its thread), single consumer (the flush) ring of [size][time][level][text] records
+		struct ThreadBuffer
+		{
+			unsigned int thread;
+			std::vector<char> data; // power of two
+			alignas(64) std::atomic<std::uint64_t> head;
+			alignas(64) std::atomic<std::uint64_t> tail;
+			std::atomic<std::uint64_t> dropped;
+			std::atomic<bool> retired; // its thread exited: nothing more will be written
+
+			ThreadBuffer(unsigned int t, std::size_t capacity):thread(t),data(capacity),head(0),tail(0),dropped(0),retired(false)
+			{}
+
+			void Copy(std::uint64_t position, const void* s, std::size_t size)
+			{
+				std::size_t offset = position & (data.size()-1);
+				std::size_t first = std::min(size, data.size()-offset);
+				std::memcpy(&data[offset], s, first);
+				std::memcpy(&data[0], static_cast<const char*>(s)+first, size-first);
+			}
+
+			void Extract(std::uint64_t position, void* s, std::size_t size) const
+			{
+				std::size_t offset = position & (data.size()-1);
+				std::size_t first = std::min(size, data.size()-offset);
+				std::memcpy(s, &data[offset], first);
+				std::memcpy(static_cast<char*>(s)+first, &data[0], size-first);
+			}
+		};
+
+		struct Entry
+		{
+			std::uint64_t time;
+			unsigned int thread;
+			int level;
+			std::string text;
+		};
+
+		std::atomic<int> _level;
+		static const std::size_t MaxSpareBuffers = 16;
+
+		std::size_t _bufferSize;
+		std::vector< std::unique_ptr<ThreadBuffer> > _buffers;
+		std::vector< std::unique_ptr<ThreadBuffer> > _spare; // drained buffers of exited threads
+		unsigned int _threads;                                // numbers given so far
+		std::mutex _registryMutex;
+
+		std::FILE* _file;
+		std::mutex _flushMutex;
+
+		std::thread _flusher;
+		std::mutex _wakeMutex;
+		std::condition_variable _wakeUp;
+		bool _stop;
+		bool _flushing; // the flusher thread runs in this process: false in forked children
+		std::atomic<bool> _urgent;
+
+		Logger(void):_level(INFO),_bufferSize(1<<18),_threads(0),_file(stderr),_stop(false),_flushing(true),_urgent(false)
+		{
+			_flusher = std::thread([this]
+			{
+				std::unique_lock<std::mutex> lock(_wakeMutex);
+				while( !_stop )
+				{
+					_wakeUp.wait_for(lock, std::chrono::milliseconds(50), [this]{ return _stop || _urgent; });
+					_urgent.store(false, std::memory_order_relaxed);
+					lock.unlock();
+					Flush();
+					lock.lock();
+				}
+			});
+		}
+
+		// registered with atexit: stops the flusher and writes the records left
+		void Shutdown(void)
+		{
+			if( _flushing )
+			{
+				{
+					std::lock_guard<std::mutex> lock(_wakeMutex);
+					_stop = true;
+				}
+				_wakeUp.notify_one();
+				_flusher.join();
+				_flushing = false;
+			}
+			Flush();
+
+			std::lock_guard<std::mutex> lock(_flushMutex);
+			if( _file != stderr ) std::fclose(_file);
+			_file = stderr;
+		}
+
+		static Logger* Create(void)
+		{
+			Logger* logger = new Logger;
+			std::atexit([]{ Instance().Shutdown(); });
+			#ifndef _WIN32
+				pthread_atfork(&BeforeFork, &AfterForkInParent, &AfterForkInChild);
+			#endif
+			return logger;
+		}
+
+		// the forking thread holds the locks, so that no other thread holds them in the child
+		static void BeforeFork(void)
+		{
+			Instance()._flushMutex.lock();
+			Instance()._registryMutex.lock();
+		}
+
+		static void AfterForkInParent(void)
+		{
+			Instance()._registryMutex.unlock();
+			Instance()._flushMutex.unlock();
+		}
+
+		// the parent writes its pending records; the child only has the forking thread left
+		static void AfterForkInChild(void)
+		{
+			Logger& logger = Instance();
+			for(const std::unique_ptr<ThreadBuffer>& b : logger._buffers)
+			{
+				b->tail.store(b->head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+				b->dropped.store(0, std::memory_order_relaxed);
+			}
+			logger._flushing = false;
+			logger._registryMutex.unlock();
+			logger._flushMutex.unlock();
+		}
+
+		ThreadBuffer& LocalBuffer(void)
+		{
+			// buffers belong to the logger, so records survive the threads that wrote them
+			struct Owner
+			{
+				ThreadBuffer* buffer = nullptr;
+				~Owner() { if( buffer ) buffer->retired.store(true, std::memory_order_release); }
+			};
+			static thread_local Owner owner;
+			if( !owner.buffer )
+			{
+				std::lock_guard<std::mutex> lock(_registryMutex);
+				std::size_t capacity = 4096;
+				while( capacity < _bufferSize ) capacity <<= 1;
+
+				if( !_spare.empty() && _spare.back()->data.size() != capacity ) _spare.clear();
+				if( _spare.empty() ) _buffers.push_back( std::unique_ptr<ThreadBuffer>(new ThreadBuffer(_threads, capacity)) );
+				else
+				{
+					_buffers.push_back( std::move(_spare.back()) );
+					_spare.pop_back();
+					_buffers.back()->thread = _threads;
+					_buffers.back()->retired.store(false, std::memory_order_relaxed);
+				}
+				_threads++;
+				owner.buffer = _buffers.back().get();
+			}
+			return *owner.buffer;
+		}
+
+		static const char* LevelName(int level)
+		{
+			static const char* names[] = { "trace", "debug", "info", "warning", "error", "off" };
+			return names[level];
+		}
+
+		static void WriteTime(std::string& s, std::uint64_t ns)
+		{
+			std::time_t seconds = ns / 1000000000ULL;
+			std::tm utc;
+			#ifdef _WIN32
+				gmtime_s(&utc, &seconds);
+			#else
+				gmtime_r(&seconds, &utc);
+			#endif
+			char buffer[40];
+			std::size_t n = std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &utc);
+			std::snprintf(buffer+n, sizeof(buffer)-n, ".%06uZ", (unsigned int)(ns/1000 % 1000000));
+			s += buffer;
+		}
+
+
+	public:
+
+		// never destroyed: the buffers of threads outliving static destruction stay valid
+		static Logger& Instance(void)
+		{
+			static Logger* logger = Create();
+			return *logger;
+		}
+
+		Logger(const Logger&) = delete;
+		Logger& operator=(const Logger&) = delete;
+
+		void SetLevel(Level level)
+		{
+			_level.store(level, std::memory_order_relaxed);
+		}
+
+		bool IsEnabled(int level) const
+		{
+			return level >= _level.load(std::memory_order_relaxed);
+		}
+
+		// size of the buffer of each thread, for the threads logging for the first time from now on
+		void SetBufferSize(std::size_t bytes)
+		{
+			std::lock_guard<std::mutex> lock(_registryMutex);
+			_bufferSize = bytes;
+		}
+
+		// appends to path from now on; false, and logging to the previous destination, if it cannot be opened
+		bool Open(const std::string& path)
+		{
+			std::FILE* file = std::fopen(path.c_str(), "a");
+			if( !file ) return false;
+
+			Flush();
+			std::lock_guard<std::mutex> lock(_flushMutex);
+			if( _file != stderr ) std::fclose(_file);
+			_file = file;
+			return true;
+		}
+
+		// formatted record text, without time, level nor thread
+		void Submit(int level, const std::string& text)
+		{
+			ThreadBuffer& buffer = LocalBuffer();
+			std::uint32_t size = text.size();
+			std::uint64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+			std::uint8_t l = level;
+			std::size_t total = sizeof(size) + sizeof(time) + sizeof(l) + size;
+
+			std::uint64_t head = buffer.head.load(std::memory_order_relaxed);
+			if( total > buffer.data.size() - (head - buffer.tail.load(std::memory_order_acquire)) )
+			{
+				buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+
+			buffer.Copy(head, &size, sizeof(size));
+			buffer.Copy(head+sizeof(size), &time, sizeof(time));
+			buffer.Copy(head+sizeof(size)+sizeof(time), &l, sizeof(l));
+			buffer.Copy(head+sizeof(size)+sizeof(time)+sizeof(l), text.data(), size);
+			buffer.head.store(head+total, std::memory_order_release);
+
+			// without the mutex a wake up may be missed: the record then waits for the next periodic flush
+			if( level >= ERROR )
+			{
+				_urgent.store(true, std::memory_order_relaxed);
+				_wakeUp.notify_one();
+			}
+		}
+
+		// writes every buffered record now, in time order
+		void Flush(void)
+		{
+			std::lock_guard<std::mutex> lock(_flushMutex);
+			std::vector<Entry> entries;
+			{
+				std::lock_guard<std::mutex> registry(_registryMutex);
+				std::size_t kept = 0;
+				for(std::unique_ptr<ThreadBuffer>& b : _buffers)
+				{
+					// read before head: once retired, the head read below is the last one
+					bool retired = b->retired.load(std::memory_order_acquire);
+					std::uint64_t tail = b->tail.load(std::memory_order_relaxed);
+					std::uint64_t head = b->head.load(std::memory_order_acquire);
+					while( tail < head )
+					{
+						std::uint32_t size;
+						std::uint8_t level;
+						Entry e;
+						b->Extract(tail, &size, sizeof(size));
+						b->Extract(tail+sizeof(size), &e.time, sizeof(e.time));
+						b->Extract(tail+sizeof(size)+sizeof(e.time), &level, sizeof(level));
+						e.text.resize(size);
+						if( size ) b->Extract(tail+sizeof(size)+sizeof(e.time)+sizeof(level), &e.text[0], size);
+						e.level = level;
+						e.thread = b->thread;
+						entries.push_back(e);
+						tail += sizeof(size)+sizeof(e.time)+sizeof(level)+size;
+					}
+					b->tail.store(tail, std::memory_order_release);
+
+					std::uint64_t dropped = b->dropped.exchange(0, std::memory_order_relaxed);
+					if( dropped )
+						entries.push_back( Entry{ entries.empty() ? 0 : entries.back().time, b->thread, WARNING,
+							"msg=\"log buffer full\" dropped="+std::to_string(dropped) } );
+
+					if( !retired ) _buffers[kept++] = std::move(b);
+					else if( _spare.size() < MaxSpareBuffers ) _spare.push_back( std::move(b) );
+				}
+				_buffers.resize(kept);
+			}
+			if( entries.empty() ) return;
+
+			std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b){ return a.time < b.time; });
+
+			std::string out;
+			for(const Entry& e : entries)
+			{
+				WriteTime(out, e.time);
+				out += " level=";
+				out += LevelName(e.level);
+				out += " thread=";
+				out += std::to_string(e.thread);
+				out += ' ';
+				out += e.text;
+				out += '\n';
+			}
+			std::fwrite(out.data(), 1, out.size(), _file);
+			std::fflush(_file);
+		}
+
+	};
+
+	// builds the text of a record, submitted when the statement ends
+	class LogRecord
+	{
+
+	private:
+
+		int _level;
+		std::string _text;
+
+		void Quote(const std::string& s)
+		{
+			_text += '"';
+			for(char c : s)
+			{
+				if( c == '"' || c == '\\' ) { _text += '\\'; _text += c; }
+				else if( c == '\n' ) _text += "\\n";
+				else if( (unsigned char)c < 0x20 ) _text += ' ';
+				else _text += c;
+			}
+			_text += '"';
+		}
+
+		void Value(const std::string& s) { Quote(s); }
+		void Value(const char* s) { Quote(s); }
+		void Value(bool b) { _text += b ? "true" : "false"; }
+
+		template<class T>
+		typename std::enable_if<std::is_integral<T>::value>::type Value(T t)
+		{
+			_text += std::to_string(t);
+		}
+
+		template<class T>
+		typename std::enable_if<std::is_floating_point<T>::value>::type Value(T t)
+		{
+			char buffer[32];
+			std::snprintf(buffer, sizeof(buffer), "%g", (double)t);
+			_text += buffer;
+		}
+
+		template<class T>
+		typename std::enable_if<!std::is_arithmetic<T>::value>::type Value(const T& t)
+		{
+			std::ostringstream ss;
+			ss << t;
+			Quote(ss.str());
+		}
+
+
+	public:
+
+		LogRecord(int level, const char* message):_level(level)
+		{
+			_text.reserve(128);
+			_text += "msg=";
+			Quote(message);
+		}
+
+		~LogRecord(void)
+		{
+			Logger::Instance().Submit(_level, _text);
+		}
+
+		template<class T>
+		LogRecord& Field(const char* key, const T& value)
+		{
+			_text += ' ';
+			_text += key;
+			_text += '=';
+			Value(value);
+			return *this;
+		}
+
+	};
+
+}
+
+#define PLIB_LOG(level, message) \
+	if( (level) < PLIB_LOG_LEVEL || !p::Logger::Instance().IsEnabled(level) ) ; \
+	else p::LogRecord(level, message)
+
+#define PLIB_LOG_TRACE(message) PLIB_LOG(p::Logger::TRACE, message)
+#define PLIB_LOG_DEBUG(message) PLIB_LOG(p::Logger::DEBUG, message)
+#define PLIB_LOG_INFO(message) PLIB_LOG(p::Logger::INFO, message)
+#define PLIB_LOG_WARNING(message) PLIB_LOG(p::Logger::WARNING, message)
+#define PLIB_LOG_ERROR(message) PLIB_LOG(p::Logger::ERROR, message)
+
+#endif
@@ -7,10 +7,21 @@
 #include <algorithm>
 #include <functional>
 #include <iterator>
-#include <set>
+#include <unordered_map>
 #include <exception>
-
-// #include <omp.h>
+#include <sstream>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+
+#include "PipelineCache.hpp"
+#include "PipelineProfiler.hpp"
+#include "Logger.hpp"
+#include "CancellationToken.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 /***************************** * 
  OpenMP instead of native threading for improved portability 
 https://software.intel.com/en-us/articles/choosing-between-openmp-and-explicit-threading-methods
@@ -20,273 +31,553 @@ https://software.intel.com/en-us/articles/choosing-between-openmp-and-explicit-t
 namespace p
 {
 
+	// prints a payload if it can be streamed, its element list for vectors, its type otherwise
+	template <typename T>
+	auto PrintPayload(std::ostream& s, const T& t, int) -> decltype(s << t, void())
+	{
+		s << t;
+	}
+
+	template <typename T>
+	void PrintPayload(std::ostream& s, const T& t, long)
+	{
+		s << "<" << typeid(T).name() << ">";
+	}
+
+	template <typename T, typename A>
+	void PrintPayload(std::ostream& s, const std::vector<T,A>& v, int)
+	{
+		s << "{";
+		for(std::size_t i=0; i<v.size(); i++)
+		{
+			if(i) s << ", ";
+			PrintPayload(s, v[i], 0);
+		}
+		s << "}";
+	}
+
+	class ProcessGroup;
+
+	// where stages suspended on I/O get resumed: the workers of the running PipelineExecutor
+	class PipelineResumer
+	{
+	public:
+		virtual ~PipelineResumer(void) {}
+		virtual void Post(std::function<void()> resume) = 0;
+
+		// resumer of the calling thread, nullptr outside of an executor
+		static PipelineResumer*& Current(void)
+		{
+			static thread_local PipelineResumer* current = nullptr;
+			return current;
+		}
+	};
+
+	/**
+	 Type erased Pipeline: what the DAG traversal needs to know about a node regardless of its I/O types.
+	 Connections are type checked once, when they are made; updates never cast again.
+	 */
+	class PipelineNode
+	{
+
+	private:
+
+		friend class PipelineExecutor;
+		friend class ProcessGroup;
+
+		// bumped on every edge change, invalidating the cached topologies
+		static std::atomic<unsigned long>& TopologyVersion(void)
+		{
+			static std::atomic<unsigned long> version(1);
+			return version;
+		}
+
+		std::vector<PipelineNode*> _topology;
+		unsigned long _topologyVersion;
+		std::mutex _topologyMutex;
+
+		static std::vector<PipelineNode*> SortTopologically(PipelineNode*);
+
+		std::string DeadlineReason(void) const;
+		// token a Run is given: run's, cancelled as well past the deadline
+		CancellationToken DeadlineToken(const CancellationToken& run) const;
+		// throws if a Run of cost ns went past the deadline
+		void CheckDeadline(double cost) const;
+
+
+	protected:
+
+		std::vector<PipelineNode*> _inputConnection;
+		std::string _name;
+		bool _displayOutput, _isCalculated;
+		bool _threading;
+		double _costEstimate; // moving average of the Run time, in ns
+		std::uint64_t _queueWait; // ns between being scheduled and started, when profiling
+		ProcessGroup* _processGroup;
+		bool _pinned;
+		std::size_t _outputBytes; // size of the last output, for memory budgets
+		std::chrono::nanoseconds _deadline; // longest Run allowed to executors, 0 for none
+
+		void TopologyChanged(void)
+		{
+			TopologyVersion()++;
+		}
+
+		// copies the outputs of _inputConnection into the node's input list
+		virtual void GatherInputs(void) = 0;
+		// processes the gathered inputs into the node's output
+		virtual void Run(void) = 0;
+		// starts Run without blocking the thread and returns true, completed being called once the output
+		// is calculated, from any thread; returns false for stages that only run synchronously
+		virtual bool RunAsync(std::function<void(std::exception_ptr)> /*completed*/) { return false; }
+		// frees the output, which will be calculated again if needed
+		virtual void ReleaseOutput(void) = 0;
+		virtual void ReleaseInputs(void) = 0;
+		// moves the output across processes, see ProcessGroup.hpp
+		virtual void WriteOutput(std::ostream&) const = 0;
+		virtual void ReadOutput(std::istream&) = 0;
+
+		virtual void toString(std::ostream& s = std::cout) {
+			s <<_name;
+		}
+
+
+	public:
+
+		PipelineNode(std::string);
+		virtual ~PipelineNode(void) {}
+
+		virtual const std::type_info& InputType(void) const = 0;
+		virtual const std::type_info& OutputType(void) const = 0;
+		virtual const void* OutputPointer(void) const = 0;
+
+		// runtime typed connection, for graphs built without static types
+		virtual PipelineNode* Connect(PipelineNode*) = 0;
+		virtual bool IsCached(void) const { return false; }
+		virtual bool CanTransferOutput(void) const = 0;
+		virtual std::size_t OutputBytes(void) const = 0;
+
+		// element-wise stages (see ElementPipeline.hpp) expose themselves for fusion
+		virtual void* ElementSourcePointer(void) { return nullptr; }
+		// asks the node to pull its elements straight from producer; false if it cannot
+		virtual bool FuseProducer(PipelineNode*) { return false; }
+
+		void Update(void);
+		void Invalidate(void);
+		PipelineNode* ValidateDAG(void);
+		const std::vector<PipelineNode*>& Topology(void);
+		const bool HasBeenCalculated(void);
+		const std::string& GetName(void) const;
+		void EnableThreading(bool);
+		// runs the node in group's child process; nullptr brings it back in process
+		void SetProcessGroup(ProcessGroup*);
+		ProcessGroup* GetProcessGroup(void) const;
+		// pinned outputs are never released by executors, see PipelineExecutor::ReleaseIntermediates
+		void Pin(bool);
+		bool IsPinned(void) const;
+		// executors fail a run whose Run takes longer than deadline, cancelling its token meanwhile; 0 for none
+		void SetDeadline(std::chrono::nanoseconds);
+		std::chrono::nanoseconds GetDeadline(void) const;
+
+		friend std::ostream & operator << (std::ostream &os, PipelineNode* p);
+		friend std::ostream & operator << (std::ostream &os, PipelineNode& p);
+
+	};
+
 	template <typename I, typename O>
-	class Pipeline
+	class Pipeline : public PipelineNode
 	{
 
 	private:
 
-		void BackPropagate(Pipeline*);
-		void CheckPipelineConnection(Pipeline*);
-		void RetroUpdate(Pipeline*);
 		O Execute(I* inputArray, int size);
+		std::string CacheKey(void);
+		bool LoadFromCache(const std::string&);
+		Pipeline* AddConnection(PipelineNode*);
 
-		static short level; //indentation level
-	
 
 	protected:
 
 		std::vector<I> _input;
-		std::vector<Pipeline*> _inputConnection;
+		std::vector<I> _constantInput;
 		O _output;
-		std::string _name;
-		bool _displayOutput, _isCalculated;
+		PipelineCache* _cache;
+		std::string _cacheParameters;
 
-		Pipeline* ValidateDAG(Pipeline*);
+		void GatherInputs(void);
+		void Run(void);
+		void WriteOutput(std::ostream& s) const { Serializer<O>::Write(s, _output); }
+		void ReadOutput(std::istream& s) { Serializer<O>::Read(s, _output); }
+		void ReleaseOutput(void) { _output = O(); _isCalculated = false; }
+		void ReleaseInputs(void) { std::vector<I>().swap(_input); }
 
 		virtual O Execute(typename std::vector<I>::iterator begin, typename std::vector<I>::iterator end) = 0; //generic iterator
 		virtual void toString(std::ostream& s = std::cout) {
-			s <<_name<<" - "<< _output;
+			s <<_name<<" - ";
+			PrintPayload(s, _output, 0);
 		}
 
 
 	public:
 
 		Pipeline(std::string);
-		void Update(void);
-		Pipeline* ValidateDAG(void);
-		Pipeline* SetInput(Pipeline*);
+
+		const std::type_info& InputType(void) const { return typeid(I); }
+		const std::type_info& OutputType(void) const { return typeid(O); }
+		const void* OutputPointer(void) const { return &_output; }
+		PipelineNode* Connect(PipelineNode*);
+		bool IsCached(void) const { return _cache != nullptr; }
+		bool CanTransferOutput(void) const { return Serializer<O>::supported; }
+		std::size_t OutputBytes(void) const { return Serializer<O>::Size(_output); }
+
+		// any Pipeline producing an I can feed this one: checked at compile time
+		template<class A>
+		Pipeline* SetInput(Pipeline<A,I>*);
 		Pipeline* SetInput(const I&);
 		const O GetOutput(void);
-		const bool HasBeenCalculated(void);
-		void EnableThreading(bool);
+		void EnableCache(PipelineCache*, std::string parameters = "");
 
 		template<template<typename ELEM, typename ALLOC=std::allocator<ELEM> > class Container>
 		Pipeline* SetInput(const Container<I> i);
 
-		template<class U,class V>
-		friend std::ostream & operator << (std::ostream &os, Pipeline<U,V>* p);
-
-		template<class U,class V>
-		friend std::ostream & operator << (std::ostream &os, Pipeline<U,V>& p);
-
 	};
 
 	class CyclicPipelineException : public std::exception
 	{
+	private:
+		std::string _what;
 	public:
 		std::string _a, _b;
 		CyclicPipelineException(std::string a, std::string b):_a(a),_b(b)
+		{
+			_what = "Pipeline is not Acyclic: "+_a+" -> "+_b+" -> ... -> "+_a;
+		}
+		virtual const char* what() const throw()
+		{
+			return _what.c_str();
+		}
+	};
+
+	class PipelineConnectionException : public std::exception
+	{
+	private:
+		std::string _what;
+	public:
+		PipelineConnectionException(std::string from, std::string to, std::string produced, std::string expected)
+		:_what("Could not connect Pipeline: '"+from+"' -> '"+to+"': produces "+produced+", expects "+expected)
 		{}
 		virtual const char* what() const throw()
 		{
-			return ("Pipeline is not Acyclic: "+_a+" -> "+_b+" -> ... -> "+_a).c_str() ;
+			return _what.c_str();
 		}
 	};
 
-	template<class I, class O>
-	short Pipeline<I,O>::level =0;
+	inline PipelineNode::PipelineNode(std::string s) : _name(s)
+	{
+		EnableThreading(true);
+		_isCalculated = false;
+		_costEstimate = 0.0;
+		_displayOutput = false;
+		_topologyVersion = 0;
+		_queueWait = 0;
+		_processGroup = nullptr;
+		_pinned = false;
+		_outputBytes = 0;
+		_deadline = std::chrono::nanoseconds::zero();
+	}
 
-	template<class I, class O>
-	Pipeline<I,O>* Pipeline<I,O>::ValidateDAG( Pipeline* root )
-	{	
-		Pipeline* cycle = nullptr;
-		static std::set<Pipeline*> finishedNodes; //black
-		static std::set<Pipeline*> knownNodes; //grey
-
-		// in case no cycle is found, all nodes are black from previous run i.e. finishedNodes is still full
-		if(knownNodes.empty()) finishedNodes.clear();
-		knownNodes.insert(root);
-
-		std::all_of(root->_inputConnection.begin(),
-					root->_inputConnection.end(),
-					[&](Pipeline* p){ 
-						// if node already visited -> cycle
-						if ( knownNodes.find( p ) != knownNodes.end() ) 
-						{
-							cycle = p;
-							finishedNodes.clear();
-							knownNodes.clear();
-							throw CyclicPipelineException( p->_name, root->_name );
-							return false; // exit (break does not work in for_each)
-						}
-						else // dfs
-						{
-							cycle = ValidateDAG( p );
-							finishedNodes.insert( p );
-							knownNodes.erase( p );
-							return true; // continue
-						}
-
-					 });
-
-		return cycle;
+	// iterative post-order DFS over the input edges: inputs come before their consumers, root is last.
+	// all state is local, so concurrent validations of different graphs do not interfere
+	inline std::vector<PipelineNode*> PipelineNode::SortTopologically( PipelineNode* root )
+	{
+		struct Frame
+		{
+			PipelineNode* node;
+			std::size_t id;
+			std::size_t next; // next input edge to explore
+		};
+		enum : char { GREY = 1, BLACK = 2 };
+
+		std::vector<PipelineNode*> order;
+		std::vector<char> color;
+		std::vector<Frame> stack;
+		std::unordered_map<PipelineNode*, std::size_t> id;
+
+		id[root] = 0;
+		color.push_back(GREY);
+		stack.push_back( Frame{root, 0, 0} );
+
+		while( !stack.empty() )
+		{
+			Frame& top = stack.back();
+
+			if( top.next < top.node->_inputConnection.size() )
+			{
+				PipelineNode* input = top.node->_inputConnection[top.next++];
+				std::pair<std::unordered_map<PipelineNode*, std::size_t>::iterator, bool> visit = id.insert( std::make_pair(input, color.size()) );
+
+				if( visit.second ) // first visit: dfs
+				{
+					color.push_back(GREY);
+					stack.push_back( Frame{input, visit.first->second, 0} );
+				}
+				// node still on the stack -> cycle
+				else if( color[visit.first->second] == GREY )
+					throw CyclicPipelineException( input->_name, top.node->_name );
+			}
+			else
+			{
+				color[top.id] = BLACK;
+				order.push_back(top.node);
+				stack.pop_back();
+			}
+		}
+
+		return order;
 	}
 
-	template<class I, class O>
-	Pipeline<I,O>* Pipeline<I,O>::ValidateDAG( void )
-	{	
-		ValidateDAG( this );
+	inline const std::vector<PipelineNode*>& PipelineNode::Topology( void )
+	{
+		std::lock_guard<std::mutex> lock(_topologyMutex);
+
+		unsigned long version = TopologyVersion();
+		if( _topologyVersion != version )
+		{
+			_topology = SortTopologically( this );
+			_topologyVersion = version;
+		}
+		return _topology;
 	}
 
-	template<class I, class O>
-	void Pipeline<I,O>::EnableThreading(bool b)
+	// returns this if the upstream graph is acyclic, throws CyclicPipelineException otherwise
+	inline PipelineNode* PipelineNode::ValidateDAG( void )
 	{
-		#ifdef _OPENMP
-			if(b) omp_set_nested(1);
-			else omp_set_nested(0);
-		#endif
+		Topology();
+		return this;
 	}
 
-	template<class I, class O>
-	std::ostream & operator<<(std::ostream &os, Pipeline<I,O>* p)
+	// Update runs ready branches concurrently, or everything on the calling thread
+	inline void PipelineNode::EnableThreading(bool b)
+	{
+		_threading = b;
+	}
+
+	inline void PipelineNode::SetProcessGroup(ProcessGroup* group)
+	{
+		_processGroup = group;
+	}
+
+	inline ProcessGroup* PipelineNode::GetProcessGroup(void) const
+	{
+		return _processGroup;
+	}
+
+	inline void PipelineNode::Pin(bool b)
+	{
+		_pinned = b;
+	}
+
+	inline bool PipelineNode::IsPinned(void) const
+	{
+		return _pinned;
+	}
+
+	inline void PipelineNode::SetDeadline(std::chrono::nanoseconds deadline)
+	{
+		_deadline = deadline;
+	}
+
+	inline std::chrono::nanoseconds PipelineNode::GetDeadline(void) const
+	{
+		return _deadline;
+	}
+
+	inline std::string PipelineNode::DeadlineReason(void) const
+	{
+		std::ostringstream reason;
+		reason << "stage '" << _name << "' exceeded its deadline of " << _deadline.count()/1e6 << "ms";
+		return reason.str();
+	}
+
+	inline CancellationToken PipelineNode::DeadlineToken(const CancellationToken& run) const
+	{
+		if( _deadline.count() <= 0 ) return run;
+		return run.WithDeadline( CancellationToken::Clock::now()+_deadline, DeadlineReason() );
+	}
+
+	inline void PipelineNode::CheckDeadline(double cost) const
+	{
+		// stages not checking their token are only caught once they return
+		if( _deadline.count() > 0 && cost > _deadline.count() )
+			throw PipelineCancelledException( DeadlineReason() );
+	}
+
+	inline std::ostream & operator<<(std::ostream &os, PipelineNode* p)
 	{
 		p->toString(os);
 		return os;
 	}
 
-	template<class I, class O>
-	std::ostream & operator<<(std::ostream &os, Pipeline<I,O>& p)
+	inline std::ostream & operator<<(std::ostream &os, PipelineNode& p)
 	{
 		p.toString(os);
 		return os;
 	}
 
+	// Update is defined along with PipelineExecutor
 
-	template<class I, class O>
-	Pipeline<I,O>::Pipeline(std::string s) : _name(s) 
+	// the next Update will run this node again, even if it was calculated before
+	inline void PipelineNode::Invalidate(void)
 	{
-		// level = 0;
-
-		EnableThreading(false);
 		_isCalculated = false;
-		_displayOutput = false;
+	}
+
+	inline const bool PipelineNode::HasBeenCalculated(void)
+	{
+		return _isCalculated;
+	}
+
+	inline const std::string& PipelineNode::GetName(void) const
+	{
+		return _name;
 	}
 
 
 	template<class I, class O>
-	void Pipeline<I,O>::BackPropagate(Pipeline* input)
+	Pipeline<I,O>::Pipeline(std::string s) : PipelineNode(s)
 	{
-		// Calculate only if needed (Memoisation)
-		if( !input->_isCalculated )
+		_cache = nullptr;
+	}
+
+	template<class I, class O>
+	void Pipeline<I,O>::EnableCache(PipelineCache* cache, std::string parameters)
+	{
+		// parameters are part of the key: changing them invalidates previous outputs
+		if( cache && (!Serializer<I>::supported || !Serializer<O>::supported) )
+			throw SerializationException("cannot cache Pipeline '"+_name+"': specialize p::Serializer for its input and output types");
+
+		_cache = cache;
+		_cacheParameters = parameters;
+	}
+
+	template<class I, class O>
+	std::string Pipeline<I,O>::CacheKey(void)
+	{
+		Hasher h;
+		h.Add(_name).Add(_cacheParameters).Add(typeid(O).name());
+
+		for(const I& i : _input)
 		{
-			// #pragma omp single
-			input->Update();
+			std::ostringstream ss;
+			Serializer<I>::Write(ss, i);
+			h.Add(ss.str());
 		}
+
+		return PipelineCache::KeyToString(h.Value());
 	}
 
 	template<class I, class O>
-	void Pipeline<I,O>::CheckPipelineConnection(Pipeline* input)
+	bool Pipeline<I,O>::LoadFromCache(const std::string& key)
 	{
-		// make sure input::output_type matches this::input_type
+		std::string bytes;
+		if( !_cache->Load(key, bytes) ) return false;
+
 		try
 		{
-			// throw an error if cast fails
-			I* typeTest = dynamic_cast<I*>( &(input->_output) );
-			// if cast succeeds
-			_input.push_back( input->_output );
+			std::istringstream ss(bytes);
+			Serializer<O>::Read(ss, _output);
 		}
-		catch (const std::bad_cast& e)
+		catch(const std::exception& e)
 		{
-			std::cerr<< "Could not connect Pipeline: '"
-			<< input->_name << "' -> '" << _name <<"'"
-			<< std::endl
-			<< e.what()
-			<< std::endl;
-			throw e;
+			// corrupted or outdated entry, length_error or bad_alloc from a corrupted size included: dropped and recomputed
+			PLIB_LOG_WARNING("cache entry dropped").Field("stage", _name).Field("error", e.what());
+			_cache->Remove(key);
+			_output = O();
+			return false;
 		}
-
+		return true;
 	}
 
-
 	template<class I, class O>
-	void Pipeline<I,O>::RetroUpdate(Pipeline* input)
+	void Pipeline<I,O>::GatherInputs(void)
 	{
-		#pragma omp task
-		{
-			try
-			{
-				level++;
-				this->BackPropagate(input);
-				this->CheckPipelineConnection(input);
-				level--;
-			}
-			catch (std::exception& e)
-			{
-				std::cerr<< "Could not backPropagate Pipeline: '"
-				<< input->_name << "' from '" << _name <<"'"
-				<< std::endl
-				<< e.what()
-				<< std::endl;
-				throw e;
-			}
-		}
+		// every connection has been checked to produce an I when it was made
+		_input.assign( _constantInput.begin(), _constantInput.end() );
+		for(PipelineNode* input : _inputConnection)
+			_input.push_back( *static_cast<const I*>(input->OutputPointer()) );
 	}
 
 	template<class I, class O>
-	void Pipeline<I,O>::Update(void)
+	void Pipeline<I,O>::Run(void)
 	{
-		static bool checkForCycle=true;
-		if( checkForCycle )
+		// Reuse a previous run's output if inputs did not change
+		std::string cacheKey;
+		if( _cache )
 		{
-
-		}
-
-
-		std::cout<< std::string(3*level,' ') << "Executing :'"<< _name <<"'";
-		#ifdef _OPENMP
-			std::cout<<" #"<<omp_get_thread_num();<<std::endl;
-		#endif
-		std::cout<<std::endl;
-
-		try{ //omp pragma not threadsafe in try statement; try only for debug
-
-			#pragma omp parallel
+			cacheKey = CacheKey();
+			if( LoadFromCache(cacheKey) )
 			{
-				if(!_inputConnection.empty())
-				#pragma omp single
-				std::for_each (std::next(_inputConnection.begin(),0),
-					_inputConnection.end(),
-					std::bind(&Pipeline::RetroUpdate,this,std::placeholders::_1));
+				_isCalculated = true;
+				return;
 			}
-
-		}
-		catch(std::exception& e)
-		{
-			std::cerr << e.what()
-			<< std::endl;
-			// throw e;
 		}
 
 		// Execute processing from input list
 		try
 		{
+			PLIB_PROFILE_BEGIN(event);
 			_output = Execute( _input.begin(), _input.end() );
+			PLIB_PROFILE_END(event, _name, _queueWait, _input.size(), Serializer<O>::Size(_output));
 			_isCalculated = true;
 		}
-		catch(std::exception& e)
+		catch(const PipelineCancelledException& e)
+		{
+			PLIB_LOG_DEBUG("stage cancelled").Field("stage", _name).Field("reason", e.what());
+			throw;
+		}
+		catch(const std::exception& e)
+		{
+			PLIB_LOG_ERROR("stage failed").Field("stage", _name).Field("error", e.what());
+			throw;
+		}
+
+		if( _cache )
 		{
-			std::cerr<< "Could not connect Execute: '"
-			<< _name <<"'"
-			<< std::endl
-			<< e.what()
-			<< std::endl;
-			throw e;
+			std::ostringstream ss;
+			Serializer<O>::Write(ss, _output);
+			_cache->Store(cacheKey, ss.str());
 		}
 	}
 
 	template<class I, class O>
-	Pipeline<I,O>* Pipeline<I,O>::SetInput( Pipeline* p)
+	Pipeline<I,O>* Pipeline<I,O>::AddConnection( PipelineNode* p)
 	{
 		_inputConnection.push_back(p);
 		_isCalculated = false;
+		TopologyChanged();
 		return this;
 	}
 
+	template<class I, class O>
+	template<class A>
+	Pipeline<I,O>* Pipeline<I,O>::SetInput( Pipeline<A,I>* p)
+	{
+		return AddConnection(p);
+	}
+
+	template<class I, class O>
+	PipelineNode* Pipeline<I,O>::Connect( PipelineNode* p)
+	{
+		if( p->OutputType() != typeid(I) )
+			throw PipelineConnectionException( p->GetName(), _name, p->OutputType().name(), typeid(I).name() );
+
+		return AddConnection(p);
+	}
+
 	template<class I, class O>
 	Pipeline<I,O>* Pipeline<I,O>::SetInput(const I& i)
 	{
-		_input.push_back(i);
+		_constantInput.push_back(i);
 		_isCalculated = false;
 		return this;
 	}
@@ -295,7 +586,7 @@ namespace p
 	template<template<typename ELEM, typename ALLOC=std::allocator<ELEM> > class Container>
 	Pipeline<I,O>* Pipeline<I,O>::SetInput(const Container<I> i)
 	{
-		std::copy(i.begin(), i.end(), std::back_inserter(_input));
+		std::copy(i.begin(), i.end(), std::back_inserter(_constantInput));
 		_isCalculated = false;
 		return this;
 	}
@@ -306,16 +597,13 @@ namespace p
 		return _output;
 	}
 
-	template<class I, class O>
-	const bool Pipeline<I,O>::HasBeenCalculated(void)
-	{
-		return _isCalculated;
-	}
-
 }
 
+#include "PipelineExecutor.hpp"
+
 #endif
 
+
 /******************************************************************************
 
 Applications
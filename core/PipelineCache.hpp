@@ -0,0 +1,245 @@
+#ifndef __pipelinecache__
+#define __pipelinecache__
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <list>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <ctime>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <utime.h>
+#include <unistd.h>
+
+#include "Serializer.hpp"
+#include "Logger.hpp"
+
+/************************************* Plib pipeline cache ******************************************************
+Content-addressed on-disk memoisation of Pipeline outputs.
+Entries are keyed by stage name, stage parameters and input hashes, so a rerun with
+unchanged inputs loads the previous output instead of calling Execute.
+
+p::PipelineCache cache("./.plib_cache", 512*1024*1024); // 512MB, least recently used entries are evicted
+fft->EnableCache(&cache, "window=1024;overlap=0.5");
+fft->Update();
+
+Recency is persisted through the files modification time, so LRU order survives across runs.
+The cache is shared between pipelines and is safe to use from concurrent Update calls.
+***************************************************************************************************************/
+
+namespace p
+{
+
+	class PipelineCache
+	{
+	private:
+
+		struct Entry
+		{
+			std::string key;
+			std::uintmax_t size;
+			std::time_t lastUse;
+		};
+
+		std::string _directory;
+		std::uintmax_t _maxBytes;
+		std::uintmax_t _currentBytes;
+
+		// most recently used first
+		std::list<Entry> _entries;
+		std::map<std::string, std::list<Entry>::iterator> _index;
+		std::mutex _mutex;
+
+		static const char* Extension(void)
+		{
+			return ".plc";
+		}
+
+		std::string PathOf(const std::string& key) const
+		{
+			return _directory + "/" + key + Extension();
+		}
+
+		// unique to this write: other threads and processes sharing the directory write their own
+		static std::string TemporaryPath(const std::string& path)
+		{
+			static std::atomic<unsigned long> writes(0);
+			std::ostringstream ss;
+			ss << path << '.' << getpid() << '.' << std::hash<std::thread::id>()(std::this_thread::get_id()) << '.' << writes++ << ".tmp";
+			return ss.str();
+		}
+
+		void Scan(void)
+		{
+			DIR* dir = opendir(_directory.c_str());
+			if(!dir) return;
+
+			std::vector<Entry> found;
+			std::string ext = Extension();
+			while(struct dirent* e = readdir(dir))
+			{
+				std::string file = e->d_name;
+				if(file.size() <= ext.size() || file.compare(file.size()-ext.size(), ext.size(), ext) != 0)
+					continue;
+
+				struct stat st;
+				if(stat((_directory+"/"+file).c_str(), &st) != 0) continue;
+
+				Entry entry = { file.substr(0, file.size()-ext.size()), (std::uintmax_t)st.st_size, st.st_mtime };
+				found.push_back(entry);
+			}
+			closedir(dir);
+
+			std::sort(found.begin(), found.end(), [](const Entry& a, const Entry& b){ return a.lastUse > b.lastUse; });
+			for(const Entry& entry : found)
+			{
+				_entries.push_back(entry);
+				_index[entry.key] = std::prev(_entries.end());
+				_currentBytes += entry.size;
+			}
+		}
+
+		// caller holds _mutex
+		void Evict(void)
+		{
+			while(_currentBytes > _maxBytes && !_entries.empty())
+			{
+				const Entry& victim = _entries.back();
+				std::remove(PathOf(victim.key).c_str());
+				_currentBytes -= victim.size;
+				_index.erase(victim.key);
+				_entries.pop_back();
+			}
+		}
+
+	public:
+
+		PipelineCache(std::string directory, std::uintmax_t maxBytes = 1024*1024*1024)
+		: _directory(directory), _maxBytes(maxBytes), _currentBytes(0)
+		{
+			mkdir(_directory.c_str(), 0755);
+			Scan();
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			Evict();
+		}
+
+		static std::string KeyToString(std::uint64_t key)
+		{
+			std::ostringstream ss;
+			ss << std::hex << std::setw(16) << std::setfill('0') << key;
+			return ss.str();
+		}
+
+		bool Load(const std::string& key, std::string& bytes)
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				std::map<std::string, std::list<Entry>::iterator>::iterator it = _index.find(key);
+				if(it == _index.end()) return false;
+
+				// mark as most recently used, in memory and on disk
+				_entries.splice(_entries.begin(), _entries, it->second);
+				_entries.front().lastUse = std::time(nullptr);
+				utime(PathOf(key).c_str(), nullptr);
+			}
+
+			std::ifstream file(PathOf(key).c_str(), std::ios::binary);
+			if(!file) return false;
+
+			std::ostringstream ss;
+			ss << file.rdbuf();
+			bytes = ss.str();
+			return true;
+		}
+
+		void Store(const std::string& key, const std::string& bytes)
+		{
+			if(bytes.size() > _maxBytes) return;
+
+			// write aside then rename: a crashed run never leaves a half written entry
+			std::string path = PathOf(key);
+			std::string tmp = TemporaryPath(path);
+			{
+				std::ofstream file(tmp.c_str(), std::ios::binary | std::ios::trunc);
+				if(!file.write(bytes.data(), bytes.size()))
+				{
+					PLIB_LOG_WARNING("cache entry not written").Field("path", tmp);
+					std::remove(tmp.c_str());
+					return;
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			if(std::rename(tmp.c_str(), path.c_str()) != 0)
+			{
+				std::remove(tmp.c_str());
+				return;
+			}
+
+			std::map<std::string, std::list<Entry>::iterator>::iterator it = _index.find(key);
+			if(it != _index.end())
+			{
+				_currentBytes -= it->second->size;
+				_entries.erase(it->second);
+			}
+
+			Entry entry = { key, bytes.size(), std::time(nullptr) };
+			_entries.push_front(entry);
+			_index[key] = _entries.begin();
+			_currentBytes += entry.size;
+
+			Evict();
+		}
+
+		// drops a corrupted entry
+		void Remove(const std::string& key)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			std::map<std::string, std::list<Entry>::iterator>::iterator it = _index.find(key);
+			if(it == _index.end()) return;
+			std::remove(PathOf(key).c_str());
+			_currentBytes -= it->second->size;
+			_entries.erase(it->second);
+			_index.erase(it);
+		}
+
+		void Clear(void)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			for(const Entry& entry : _entries) std::remove(PathOf(entry.key).c_str());
+			_entries.clear();
+			_index.clear();
+			_currentBytes = 0;
+		}
+
+		void SetMaxBytes(std::uintmax_t m)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_maxBytes = m;
+			Evict();
+		}
+
+		std::uintmax_t Size(void)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _currentBytes;
+		}
+
+	};
+
+}
+
+#endif
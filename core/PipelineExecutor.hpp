@@ -0,0 +1,569 @@
+#ifndef __pipelineexecutor__
+#define __pipelineexecutor__
+
+#include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <deque>
+#include <functional>
+
+#include "Pipeline.hpp"
+#include "ProcessGroup.hpp"
+
+/************************************* Plib pipeline executor ******************************************************
+Runs the upstream DAG of a Pipeline node on a team of OpenMP threads.
+
+p::PipelineExecutor executor(p::PipelineExecutor::CRITICAL_PATH, 8);
+executor.Run(sink); // what sink->Update() does, with the default policy
+
+Nodes become ready once all their inputs are calculated. Among ready nodes:
+ - FIFO runs them in the order they became ready
+ - CRITICAL_PATH runs first the node heading the longest remaining path to the sink,
+   path lengths being the sum of the nodes' estimated costs
+Costs are an exponential moving average of each node's past Execute times, so the schedule
+improves over repeated runs of the same graph. Nodes never run are given the average cost.
+The members of a ProcessGroup are scheduled together, as one unit costing the sum of theirs.
+Stages suspended on I/O (see AsyncPipeline.hpp) do not hold a thread: they are resumed by whichever
+worker is free once their I/O completes, before any new stage is started.
+
+executor.ReleaseIntermediates(true);   // outputs are freed once their last consumer has run, unless pinned
+executor.SetMemoryBudget(512<<20);     // past 512MB of live outputs, prefer the stages freeing the most
+executor.Run(sink);
+std::cout << executor.PeakBytes();     // bytes of live outputs at the worst point of the run
+Sizes are those given by p::Serializer::Size. A released node is calculated again by the next Update
+needing it: pin the ones to memoise (node->Pin(true)).
+
+node->SetDeadline(std::chrono::milliseconds(200)); // the run fails if node's Run takes longer
+executor.Run(sink, token);                          // stops starting stages once token is cancelled (CancellationToken.hpp)
+The first error, a cancellation or a missed deadline, cancels the token of the stages still running and is
+rethrown by Run once they have returned. Process groups are killed straight away.
+
+Stages using OpenMP themselves get nested teams: Run raises omp_set_max_active_levels to allow them, as
+omp_set_nested(1) did. Data parallel stages (BatchPipeline.hpp, DataParallel.hpp) use the shared ThreadPool.
+***************************************************************************************************************/
+
+namespace p
+{
+
+	class PipelineExecutor
+	{
+
+	public:
+
+		enum Policy { FIFO, CRITICAL_PATH };
+
+
+	private:
+
+		Policy _policy;
+		unsigned int _threads;
+		bool _release;
+		std::size_t _budget;
+		std::size_t _peakBytes;
+
+		struct Task
+		{
+			double priority;
+			std::size_t sequence;
+			std::size_t node;
+
+			// heaps pop the greatest: highest priority, then first ready
+			bool operator<(const Task& t) const
+			{
+				if( priority != t.priority ) return priority < t.priority;
+				return sequence > t.sequence;
+			}
+		};
+
+		static double Now(void)
+		{
+			return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+
+	public:
+
+		// threads = 0 uses one thread per core
+		PipelineExecutor(Policy policy = CRITICAL_PATH, unsigned int threads = 0)
+		: _policy(policy), _threads(threads), _release(false), _budget(0), _peakBytes(0)
+		{}
+
+		void SetPolicy(Policy policy)
+		{
+			_policy = policy;
+		}
+
+		void SetThreads(unsigned int threads)
+		{
+			_threads = threads;
+		}
+
+		// frees the outputs computed during a run once all their consumers have run, except the sink's and pinned ones
+		void ReleaseIntermediates(bool release)
+		{
+			_release = release;
+		}
+
+		// bytes of live outputs above which the stages lowering memory the most are run first; 0 for no budget
+		void SetMemoryBudget(std::size_t bytes)
+		{
+			_budget = bytes;
+		}
+
+		// highest amount of output bytes alive at once during the last run
+		std::size_t PeakBytes(void) const
+		{
+			return _peakBytes;
+		}
+
+		// updates every input of sink that is not calculated yet, then sink itself, until token is cancelled
+		void Run(PipelineNode* sink, CancellationToken token = CancellationToken());
+
+	};
+
+	inline void PipelineExecutor::Run(PipelineNode* sink, CancellationToken token)
+	{
+		const std::vector<PipelineNode*>& order = sink->Topology();
+		const std::size_t n = order.size();
+
+		std::unordered_map<PipelineNode*, std::size_t> index;
+		index.reserve(n);
+		for(std::size_t i=0; i<n; i++) index[order[i]] = i;
+
+		// memoisation: the sink always runs, calculated nodes do not and shield their own inputs
+		std::vector<char> done(n, 1);
+		done[n-1] = 0; // sink is last in topological order
+		for(std::size_t i=n; i-- > 0;)
+			if( !done[i] )
+				for(PipelineNode* input : order[i]->_inputConnection)
+					if( !input->_isCalculated ) done[index[input]] = 0;
+
+		std::vector<std::size_t> nbConsumers(n, 0);
+		for(std::size_t i=0; i<n; i++)
+			if( !done[i] )
+				for(PipelineNode* input : order[i]->_inputConnection)
+					nbConsumers[index[input]]++;
+
+		// fusion: an element-wise producer feeding a single element-wise consumer is run inside it,
+		// so its output collection is never materialised. Cached nodes need their real inputs.
+		std::vector<char> fused(n, 0);
+		for(std::size_t i=0; i<n; i++)
+		{
+			if( done[i] ) continue;
+			PipelineNode* node = order[i];
+			PipelineNode* producer = nullptr;
+
+			if( node->_inputConnection.size() == 1 && !node->IsCached() && !node->_processGroup )
+			{
+				std::size_t j = index[node->_inputConnection[0]];
+				if( !done[j] && nbConsumers[j] == 1 && order[j]->ElementSourcePointer() && !order[j]->IsCached() && !order[j]->_processGroup )
+					producer = order[j];
+			}
+
+			// always called, to forget the fusion of a previous run
+			if( node->FuseProducer(producer) && producer ) fused[index[producer]] = 1;
+		}
+
+		// a process group is one unit, represented by its first member in topological order
+		std::vector<std::size_t> unit(n);
+		std::vector< std::vector<std::size_t> > members(n); // members of the groups, indexed by unit
+		std::unordered_map<ProcessGroup*, std::size_t> groupUnit;
+		for(std::size_t i=0; i<n; i++)
+		{
+			unit[i] = i;
+			ProcessGroup* group = order[i]->_processGroup;
+			if( done[i] || fused[i] || !group ) continue;
+
+			unit[i] = groupUnit.insert( std::make_pair(group, i) ).first->second;
+			members[unit[i]].push_back(i);
+		}
+
+		// outputs leaving their group have to be sent back by the child process
+		std::vector<char> exported(n, 0);
+		exported[n-1] = 1;
+		for(std::size_t i=0; i<n; i++)
+			if( !done[i] )
+				for(PipelineNode* input : order[i]->_inputConnection)
+				{
+					ProcessGroup* group = input->_processGroup;
+					if( group && group != order[i]->_processGroup ) exported[index[input]] = 1;
+				}
+
+		std::size_t remaining = 0;
+		for(std::size_t i=0; i<n; i++)
+			if( !done[i] && !fused[i] && unit[i] == i ) remaining++;
+
+		// consumers of each scheduled unit, as a flat adjacency list; fused nodes are looked through
+		std::vector<std::size_t> pending(n, 0), consumerStart(n+1, 0), consumers, stack;
+		std::vector< std::pair<std::size_t, std::size_t> > edges;
+		for(std::size_t i=0; i<n; i++)
+		{
+			if( done[i] || fused[i] ) continue;
+
+			stack.assign(1, i);
+			while( !stack.empty() )
+			{
+				std::size_t k = stack.back();
+				stack.pop_back();
+				for(PipelineNode* input : order[k]->_inputConnection)
+				{
+					std::size_t j = index[input];
+					if( fused[j] ) stack.push_back(j);
+					else if( !done[j] && unit[j] != unit[i] ) edges.push_back( std::make_pair(unit[j], unit[i]) );
+				}
+			}
+		}
+
+		for(const std::pair<std::size_t, std::size_t>& e : edges) consumerStart[e.first+1]++;
+		for(std::size_t i=0; i<n; i++) consumerStart[i+1] += consumerStart[i];
+
+		consumers.resize(consumerStart[n]);
+		std::vector<std::size_t> fill(consumerStart.begin(), consumerStart.end()-1);
+		for(const std::pair<std::size_t, std::size_t>& e : edges)
+		{
+			consumers[fill[e.first]++] = e.second;
+			pending[e.second]++;
+		}
+
+		// output lifetimes: producers of each unit, and how many consumers each output still waits for
+		std::vector<std::size_t> producerStart(n+1, 0), producers(edges.size()), uses(n, 0);
+		for(const std::pair<std::size_t, std::size_t>& e : edges)
+		{
+			producerStart[e.second+1]++;
+			uses[e.first]++;
+		}
+		for(std::size_t i=0; i<n; i++) producerStart[i+1] += producerStart[i];
+		fill.assign(producerStart.begin(), producerStart.end()-1);
+		for(const std::pair<std::size_t, std::size_t>& e : edges)
+			producers[fill[e.second]++] = e.first;
+
+		// outputs of process groups stay, as the group is the unit
+		auto releasable = [&](std::size_t i)
+		{
+			return _release && i != n-1 && members[i].empty() && !order[i]->_pinned;
+		};
+
+		std::vector<std::size_t> held(n, 0); // bytes of the outputs computed during this run and still alive
+		std::size_t live = 0;
+		_peakBytes = 0;
+
+		// units in topological order; groups make order unusable, as a unit takes the place of its first member
+		std::vector<std::size_t> unitOrder, waiting(pending);
+		for(std::size_t i=0; i<n; i++)
+			if( !done[i] && !fused[i] && unit[i] == i && waiting[i] == 0 ) unitOrder.push_back(i);
+		for(std::size_t k=0; k<unitOrder.size(); k++)
+			for(std::size_t c=consumerStart[unitOrder[k]]; c<consumerStart[unitOrder[k]+1]; c++)
+				if( --waiting[consumers[c]] == 0 ) unitOrder.push_back(consumers[c]);
+
+		// only a path leaving a group and coming back into it can leave units waiting on each other
+		if( unitOrder.size() != remaining )
+			for(std::size_t i=0; i<n; i++)
+				if( !members[i].empty() && waiting[i] )
+					throw PipelineProcessException( order[i]->_processGroup->GetName(), "a path leaves the group and comes back into it" );
+
+		// upward rank: own cost + longest path through the consumers
+		std::vector<double> rank(n, 0.0);
+		if( _policy == CRITICAL_PATH )
+		{
+			double known = 0.0;
+			std::size_t nbKnown = 0;
+			for(PipelineNode* node : order)
+				if( node->_costEstimate > 0 ) { known += node->_costEstimate; nbKnown++; }
+			double unknown = nbKnown ? known/nbKnown : 1.0;
+
+			for(std::size_t k=unitOrder.size(); k-- > 0;)
+			{
+				std::size_t i = unitOrder[k];
+				double longest = 0.0;
+				for(std::size_t c=consumerStart[i]; c<consumerStart[i+1]; c++)
+					longest = std::max(longest, rank[consumers[c]]);
+
+				if( members[i].empty() ) rank[i] = order[i]->_costEstimate > 0 ? order[i]->_costEstimate : unknown;
+				for(std::size_t m : members[i])
+					rank[i] += order[m]->_costEstimate > 0 ? order[m]->_costEstimate : unknown;
+				rank[i] += longest;
+			}
+		}
+
+		std::vector<Task> ready; // heap
+		std::size_t sequence = 0;
+		#ifdef PLIB_PIPELINE_PROFILING
+			std::vector<std::uint64_t> readyTime(n, 0);
+		#endif
+		for(std::size_t i=0; i<n; i++)
+			if( !done[i] && !fused[i] && unit[i] == i && pending[i] == 0 )
+			{
+				ready.push_back( Task{rank[i], sequence++, i} );
+				std::push_heap(ready.begin(), ready.end());
+				#ifdef PLIB_PIPELINE_PROFILING
+					readyTime[i] = PipelineProfiler::Instance().Now();
+				#endif
+			}
+
+		std::mutex mutex;
+		std::condition_variable wakeUp;
+		std::exception_ptr error;
+		CancellationToken run = token.Child(); // cancelled at the first error
+		std::size_t running = 0; // units started and not completed, suspended ones included
+
+		// stages suspended on I/O are resumed by the workers, before any new unit is started
+		struct Resumer : public PipelineResumer
+		{
+			std::mutex& mutex;
+			std::condition_variable& wakeUp;
+			std::deque< std::function<void()> > queue;
+
+			Resumer(std::mutex& m, std::condition_variable& c):mutex(m),wakeUp(c)
+			{}
+
+			void Post(std::function<void()> resume)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				queue.push_back(resume);
+				wakeUp.notify_one();
+			}
+		} resumer(mutex, wakeUp);
+
+		// the following are called with mutex held
+		auto stop = [&](std::exception_ptr e, const std::string& reason)
+		{
+			if( !error )
+			{
+				error = e;
+				run.Cancel(reason);
+			}
+			wakeUp.notify_all();
+		};
+
+		auto fail = [&](std::size_t i, std::exception_ptr e)
+		{
+			running--;
+			stop(e, "'"+(members[i].empty() ? order[i]->_name : order[i]->_processGroup->GetName())+"' failed");
+		};
+
+		auto complete = [&](std::size_t i, const std::vector<double>& costs, std::size_t bytes)
+		{
+			for(std::size_t m=0; m<costs.size(); m++)
+			{
+				PipelineNode* member = members[i].empty() ? order[i] : order[members[i][m]];
+				member->_costEstimate = member->_costEstimate > 0 ? 0.75*member->_costEstimate + 0.25*costs[m] : costs[m];
+			}
+			running--;
+			remaining--;
+
+			held[i] = bytes;
+			live += bytes;
+			_peakBytes = std::max(_peakBytes, live);
+			if( members[i].empty() ) order[i]->_outputBytes = bytes;
+
+			for(std::size_t p=producerStart[i]; p<producerStart[i+1]; p++)
+			{
+				std::size_t j = producers[p];
+				if( --uses[j] == 0 && releasable(j) )
+				{
+					live -= held[j];
+					held[j] = 0;
+					order[j]->ReleaseOutput();
+				}
+			}
+			if( _release && members[i].empty() ) order[i]->ReleaseInputs();
+
+			std::size_t released = 0;
+			for(std::size_t c=consumerStart[i]; c<consumerStart[i+1]; c++)
+				if( --pending[consumers[c]] == 0 )
+				{
+					ready.push_back( Task{rank[consumers[c]], sequence++, consumers[c]} );
+					std::push_heap(ready.begin(), ready.end());
+					#ifdef PLIB_PIPELINE_PROFILING
+						readyTime[consumers[c]] = PipelineProfiler::Instance().Now();
+					#endif
+					released++;
+				}
+
+			if( remaining == 0 || error ) wakeUp.notify_all();
+			else if( released > 1 ) wakeUp.notify_all();
+			else if( released == 1 ) wakeUp.notify_one();
+		};
+
+		// bytes a unit would add to the live outputs, once the inputs it is the last consumer of are freed
+		auto growth = [&](std::size_t i)
+		{
+			double bytes = 0;
+			if( members[i].empty() ) bytes = order[i]->_outputBytes;
+			for(std::size_t m : members[i])
+				if( exported[m] ) bytes += order[m]->_outputBytes;
+
+			for(std::size_t p=producerStart[i]; p<producerStart[i+1]; p++)
+				if( uses[producers[p]] == 1 && releasable(producers[p]) ) bytes -= held[producers[p]];
+			return bytes;
+		};
+
+		// highest priority first, unless it would go over budget: then the unit growing memory the least
+		auto pop = [&]()
+		{
+			std::size_t best = 0;
+			if( _budget && live + growth(ready[0].node) > _budget )
+			{
+				double least = growth(ready[0].node);
+				for(std::size_t k=1; k<ready.size(); k++)
+				{
+					double g = growth(ready[k].node);
+					if( g < least ) { least = g; best = k; }
+				}
+			}
+
+			std::size_t i = ready[best].node;
+			if( best == 0 ) std::pop_heap(ready.begin(), ready.end());
+			else
+			{
+				ready[best] = ready.back();
+				std::make_heap(ready.begin(), ready.end()-1);
+			}
+			ready.pop_back();
+			return i;
+		};
+
+		auto worker = [&]()
+		{
+			PipelineResumer* previous = PipelineResumer::Current();
+			PipelineResumer::Current() = &resumer;
+			CancellationToken previousToken = CancellationToken::Current();
+			CancellationToken::Current() = run;
+
+			std::unique_lock<std::mutex> lock(mutex);
+			for(;;)
+			{
+				// after an error, only the running stages are waited for.
+				// Cancel does not notify: idle workers look at the token every 10ms
+				while( !wakeUp.wait_for(lock, std::chrono::milliseconds(10), [&]{
+					return remaining == 0 || !resumer.queue.empty() || (error ? running == 0 : !ready.empty() || run.IsCancelled());
+				}) );
+				if( remaining == 0 ) break;
+
+				if( !error && run.IsCancelled() )
+				{
+					std::string reason = run.Reason();
+					stop( std::make_exception_ptr(PipelineCancelledException(reason)), reason );
+					continue;
+				}
+
+				if( !resumer.queue.empty() )
+				{
+					std::function<void()> resume = resumer.queue.front();
+					resumer.queue.pop_front();
+					lock.unlock();
+					resume();
+					lock.lock();
+					continue;
+				}
+				if( error ) break;
+
+				std::size_t i = pop();
+				running++;
+				PipelineNode* node = order[i];
+				#ifdef PLIB_PIPELINE_PROFILING
+					node->_queueWait = PipelineProfiler::Instance().Now() - readyTime[i];
+				#endif
+				lock.unlock();
+
+				PLIB_LOG_DEBUG("executing").Field("stage", members[i].empty() ? node->_name : node->_processGroup->GetName());
+
+				double start = Now();
+				std::vector<double> costs;
+				std::size_t bytes = 0;
+				try
+				{
+					if( members[i].empty() )
+					{
+						node->GatherInputs();
+						CancellationToken::Current() = node->DeadlineToken(run);
+
+						// completed may run on another thread, even before RunAsync returns
+						bool suspended = node->RunAsync( [&, i, start](std::exception_ptr e)
+						{
+							double cost = Now()-start;
+							if( !e )
+								try { order[i]->CheckDeadline(cost); }
+								catch(...) { e = std::current_exception(); }
+
+							std::size_t bytes = e ? 0 : order[i]->OutputBytes();
+							std::lock_guard<std::mutex> guard(mutex);
+							if( e ) fail(i, e);
+							else complete( i, std::vector<double>(1, cost), bytes );
+						});
+						if( suspended )
+						{
+							CancellationToken::Current() = run;
+							lock.lock();
+							continue;
+						}
+
+						node->Run();
+						CancellationToken::Current() = run;
+						costs.assign(1, Now()-start);
+						node->CheckDeadline(costs[0]);
+						bytes = node->OutputBytes();
+					}
+					else
+					{
+						std::vector<PipelineNode*> nodes;
+						std::vector<char> flags;
+						for(std::size_t m : members[i])
+						{
+							nodes.push_back(order[m]);
+							flags.push_back(exported[m]);
+						}
+						costs = node->_processGroup->Run(nodes, flags);
+						for(std::size_t m=0; m<nodes.size(); m++)
+							if( flags[m] ) bytes += nodes[m]->OutputBytes();
+					}
+				}
+				catch(...)
+				{
+					CancellationToken::Current() = run;
+					lock.lock();
+					fail( i, std::current_exception() );
+					continue;
+				}
+
+				lock.lock();
+				complete(i, costs, bytes);
+			}
+
+			lock.unlock();
+			PipelineResumer::Current() = previous;
+			CancellationToken::Current() = previousToken;
+		};
+
+		unsigned int threads = _threads ? _threads : std::max(1u, std::thread::hardware_concurrency());
+		if( threads > remaining ) threads = remaining;
+
+		if( threads <= 1 ) worker();
+		else
+		{
+			#ifdef _OPENMP
+			// stages may open OpenMP regions of their own, nested in the team: let them have threads
+			if( omp_get_max_active_levels() < omp_get_level()+2 ) omp_set_max_active_levels(omp_get_level()+2);
+			#endif
+			#pragma omp parallel num_threads(threads)
+			worker();
+		}
+
+		if( error ) std::rethrow_exception(error);
+	}
+
+	inline void PipelineNode::Update(void)
+	{
+		PipelineExecutor executor(PipelineExecutor::CRITICAL_PATH, _threading ? 0 : 1);
+		executor.Run(this);
+	}
+
+}
+
+#endif
@@ -0,0 +1,283 @@
+#ifndef __pipelinegraph__
+#define __pipelinegraph__
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include <initializer_list>
+#include <exception>
+#include <algorithm>
+
+#include "Pipeline.hpp"
+
+/************************************* Plib pipeline graph ******************************************************
+Pipeline DAGs built at runtime from stage type names, so topologies change without recompiling.
+
+class Scale : public p::Pipeline<double,double>
+{
+	double _factor;
+	double Execute(std::vector<double>::iterator begin, std::vector<double>::iterator end) { ... }
+public:
+	Scale(std::string name, const p::PipelineParameters& parameters)
+	:Pipeline(name), _factor(parameters.Get<double>("factor", 1.0)) {}
+};
+PLIB_REGISTER_STAGE(Scale); // at namespace scope, in one translation unit
+
+p::PipelineGraph graph;
+graph.AddStage("Scale", "double", {{"factor","2"}});
+graph.AddStage("Scale", "triple", {{"factor","3"}});
+graph.Connect("double", "triple");
+graph.SetSink("triple");
+graph.Update();
+
+xmlreader/PipelineLoader.hpp fills a PipelineGraph from an XML description.
+Stages are type checked when connected, the graph is validated once, in Validate or at its first Update,
+then every Update goes straight to its PipelineExecutor.
+***************************************************************************************************************/
+
+namespace p
+{
+
+	class PipelineGraphException : public std::exception
+	{
+	private:
+		std::string _what;
+	public:
+		PipelineGraphException(std::string what):_what(what)
+		{}
+		virtual const char* what() const throw()
+		{
+			return _what.c_str();
+		}
+	};
+
+	// string parameters of a stage, converted on access
+	class PipelineParameters
+	{
+	private:
+
+		std::map<std::string, std::string> _values;
+
+	public:
+
+		PipelineParameters(void)
+		{}
+
+		PipelineParameters(std::initializer_list< std::pair<const std::string, std::string> > values):_values(values)
+		{}
+
+		void Set(const std::string& key, const std::string& value)
+		{
+			_values[key] = value;
+		}
+
+		bool Has(const std::string& key) const
+		{
+			return _values.find(key) != _values.end();
+		}
+
+		const std::map<std::string, std::string>& Values(void) const
+		{
+			return _values;
+		}
+
+		// defaultValue if the parameter is missing; throws if it cannot be read as a T
+		template<class T>
+		T Get(const std::string& key, const T& defaultValue = T()) const
+		{
+			std::map<std::string, std::string>::const_iterator it = _values.find(key);
+			if( it == _values.end() ) return defaultValue;
+
+			T value;
+			std::istringstream ss(it->second);
+			ss >> std::boolalpha >> value;
+			if( ss.fail() || !(ss >> std::ws).eof() )
+				throw PipelineGraphException("parameter '"+key+"': cannot convert '"+it->second+"'");
+			return value;
+		}
+
+	};
+
+	template<>
+	inline std::string PipelineParameters::Get<std::string>(const std::string& key, const std::string& defaultValue) const
+	{
+		std::map<std::string, std::string>::const_iterator it = _values.find(key);
+		return it == _values.end() ? defaultValue : it->second;
+	}
+
+	// stage type name -> factory
+	class PipelineRegistry
+	{
+
+	public:
+
+		typedef std::function<PipelineNode*(const std::string& name, const PipelineParameters&)> Factory;
+
+
+	private:
+
+		std::map<std::string, Factory> _factories;
+
+
+	public:
+
+		static PipelineRegistry& Instance(void)
+		{
+			static PipelineRegistry registry;
+			return registry;
+		}
+
+		void Register(const std::string& type, Factory factory)
+		{
+			_factories[type] = factory;
+		}
+
+		// Stage has to be constructible from (std::string name, const PipelineParameters&)
+		template<class Stage>
+		void Register(const std::string& type)
+		{
+			Register(type, [](const std::string& name, const PipelineParameters& parameters) -> PipelineNode*
+			{
+				return new Stage(name, parameters);
+			});
+		}
+
+		bool Has(const std::string& type) const
+		{
+			return _factories.find(type) != _factories.end();
+		}
+
+		PipelineNode* Create(const std::string& type, const std::string& name, const PipelineParameters& parameters) const
+		{
+			std::map<std::string, Factory>::const_iterator it = _factories.find(type);
+			if( it == _factories.end() )
+				throw PipelineGraphException("stage '"+name+"': unknown type '"+type+"'");
+			return it->second(name, parameters);
+		}
+
+	};
+
+	// registers Stage under its own name at static initialisation
+	template<class Stage>
+	struct PipelineRegistrar
+	{
+		PipelineRegistrar(const std::string& type)
+		{
+			PipelineRegistry::Instance().Register<Stage>(type);
+		}
+	};
+
+	#define PLIB_REGISTER_STAGE(Stage) static p::PipelineRegistrar<Stage> plibRegistrar##Stage(#Stage)
+
+	// owns the stages it creates and runs its sink with the graph's executor settings
+	class PipelineGraph
+	{
+
+	private:
+
+		const PipelineRegistry& _registry;
+		std::vector< std::unique_ptr<PipelineNode> > _stages;
+		std::map<std::string, PipelineNode*> _byName;
+		std::map< std::string, std::unique_ptr<ProcessGroup> > _processGroups;
+		PipelineNode* _sink;
+		PipelineExecutor _executor;
+		bool _validated;
+
+	public:
+
+		PipelineGraph(const PipelineRegistry& registry = PipelineRegistry::Instance())
+		:_registry(registry), _sink(nullptr), _validated(false)
+		{}
+
+		PipelineGraph(const PipelineGraph&) = delete;
+		PipelineGraph& operator=(const PipelineGraph&) = delete;
+
+		PipelineNode* AddStage(const std::string& type, const std::string& name, const PipelineParameters& parameters = PipelineParameters())
+		{
+			if( _byName.count(name) ) throw PipelineGraphException("stage '"+name+"' defined twice");
+
+			_stages.push_back( std::unique_ptr<PipelineNode>( _registry.Create(type, name, parameters) ) );
+			_byName[name] = _stages.back().get();
+			_validated = false;
+			return _stages.back().get();
+		}
+
+		PipelineNode* Get(const std::string& name) const
+		{
+			std::map<std::string, PipelineNode*>::const_iterator it = _byName.find(name);
+			if( it == _byName.end() ) throw PipelineGraphException("unknown stage '"+name+"'");
+			return it->second;
+		}
+
+		// inputs are gathered in the order of the Connect calls
+		void Connect(const std::string& from, const std::string& to)
+		{
+			Get(to)->Connect( Get(from) );
+			_validated = false;
+		}
+
+		// stages of the same group name run together in a child process
+		void SetProcessGroup(const std::string& stage, const std::string& group)
+		{
+			std::unique_ptr<ProcessGroup>& g = _processGroups[group];
+			if( !g ) g.reset( new ProcessGroup(group) );
+			Get(stage)->SetProcessGroup( g.get() );
+		}
+
+		void SetSink(const std::string& name)
+		{
+			_sink = Get(name);
+			_validated = false;
+		}
+
+		PipelineNode* GetSink(void) const
+		{
+			return _sink;
+		}
+
+		PipelineExecutor& Executor(void)
+		{
+			return _executor;
+		}
+
+		const std::vector< std::unique_ptr<PipelineNode> >& Stages(void) const
+		{
+			return _stages;
+		}
+
+		// throws if there is no sink or the graph has a cycle; lists the stages the sink does not depend on
+		std::vector<std::string> Validate(void)
+		{
+			if( !_sink ) throw PipelineGraphException("no sink");
+			const std::vector<PipelineNode*>& topology = _sink->ValidateDAG()->Topology();
+
+			std::vector<std::string> unused;
+			for(const std::unique_ptr<PipelineNode>& stage : _stages)
+				if( std::find(topology.begin(), topology.end(), stage.get()) == topology.end() )
+					unused.push_back( stage->GetName() );
+
+			_validated = true;
+			return unused;
+		}
+
+		void Update(CancellationToken token = CancellationToken())
+		{
+			if( !_validated ) Validate();
+			_executor.Run(_sink, token);
+		}
+
+		// every stage calculated again at the next Update
+		void Invalidate(void)
+		{
+			for(const std::unique_ptr<PipelineNode>& stage : _stages) stage->Invalidate();
+		}
+
+	};
+
+}
+
+#endif
@@ -0,0 +1,250 @@
+#ifndef __pipelineprofiler__
+#define __pipelineprofiler__
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+
+/************************************* Plib pipeline profiler ******************************************************
+Per stage timing and throughput of Pipeline executions.
+Compiled out unless PLIB_PIPELINE_PROFILING is defined (-DPLIB_PIPELINE_PROFILING).
+
+sink->Update();
+p::PipelineProfiler::Instance().WriteSummary(std::cout);
+std::ofstream trace("pipeline.json");
+p::PipelineProfiler::Instance().WriteChromeTrace(trace); // open in chrome://tracing or ui.perfetto.dev
+
+Each thread records into its own buffer, without locking; the registry lock is only taken once per thread.
+Export and Clear are meant to be called while no Pipeline is running.
+***************************************************************************************************************/
+
+namespace p
+{
+
+	struct PipelineEvent
+	{
+		std::string name;
+		unsigned int thread;    // small sequential id, not the OS id
+		std::uint64_t start;    // ns since the profiler was created
+		std::uint64_t wall;     // ns
+		std::uint64_t cpu;      // ns of cpu time spent by the thread
+		std::uint64_t wait;     // ns between the stage being ready and being started
+		std::size_t items;      // input elements processed
+		std::size_t bytes;      // size of the produced output
+	};
+
+	class PipelineProfiler
+	{
+	private:
+
+		struct ThreadBuffer
+		{
+			unsigned int thread;
+			std::vector<PipelineEvent> events;
+		};
+
+		std::chrono::steady_clock::time_point _epoch;
+		std::vector< std::unique_ptr<ThreadBuffer> > _buffers;
+		std::mutex _registryMutex;
+
+		PipelineProfiler(void):_epoch(std::chrono::steady_clock::now())
+		{}
+
+		ThreadBuffer& LocalBuffer(void)
+		{
+			// buffers belong to the profiler, so events survive the threads that recorded them
+			static thread_local ThreadBuffer* buffer = nullptr;
+			if(!buffer)
+			{
+				std::lock_guard<std::mutex> lock(_registryMutex);
+				_buffers.push_back( std::unique_ptr<ThreadBuffer>(new ThreadBuffer()) );
+				buffer = _buffers.back().get();
+				buffer->thread = _buffers.size()-1;
+				buffer->events.reserve(1024);
+			}
+			return *buffer;
+		}
+
+		static void WriteEscaped(std::ostream& os, const std::string& s)
+		{
+			for(char c : s)
+			{
+				if(c == '"' || c == '\\') os << '\\' << c;
+				else if((unsigned char)c < 0x20) os << ' ';
+				else os << c;
+			}
+		}
+
+	public:
+
+		static PipelineProfiler& Instance(void)
+		{
+			static PipelineProfiler profiler;
+			return profiler;
+		}
+
+		std::uint64_t Now(void) const
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-_epoch).count();
+		}
+
+		static std::uint64_t ThreadCpuNow(void)
+		{
+			#ifdef CLOCK_THREAD_CPUTIME_ID
+				timespec ts;
+				clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+				return (std::uint64_t)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+			#else
+				return (std::uint64_t)std::clock()*1000000000ULL/CLOCKS_PER_SEC;
+			#endif
+		}
+
+		void Record(PipelineEvent e)
+		{
+			ThreadBuffer& buffer = LocalBuffer();
+			e.thread = buffer.thread;
+			buffer.events.push_back(e);
+		}
+
+		std::vector<PipelineEvent> Events(void)
+		{
+			std::lock_guard<std::mutex> lock(_registryMutex);
+			std::vector<PipelineEvent> events;
+			for(const std::unique_ptr<ThreadBuffer>& b : _buffers)
+				events.insert(events.end(), b->events.begin(), b->events.end());
+
+			std::sort(events.begin(), events.end(), [](const PipelineEvent& a, const PipelineEvent& b){ return a.start < b.start; });
+			return events;
+		}
+
+		void Clear(void)
+		{
+			std::lock_guard<std::mutex> lock(_registryMutex);
+			for(const std::unique_ptr<ThreadBuffer>& b : _buffers) b->events.clear();
+		}
+
+		// Trace Event Format, complete events ("ph":"X") in microseconds
+		void WriteChromeTrace(std::ostream& os)
+		{
+			std::vector<PipelineEvent> events = Events();
+			std::ios::fmtflags flags = os.flags();
+			std::streamsize precision = os.precision();
+
+			os << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+			for(std::size_t i=0; i<events.size(); i++)
+			{
+				const PipelineEvent& e = events[i];
+				os << (i ? ",\n" : "\n")
+				<< "{\"name\":\"";
+				WriteEscaped(os, e.name);
+				os << "\",\"cat\":\"pipeline\",\"ph\":\"X\",\"pid\":0"
+				<< ",\"tid\":" << e.thread
+				<< ",\"ts\":" << e.start/1000.0
+				<< ",\"dur\":" << e.wall/1000.0
+				<< ",\"args\":{\"cpu_us\":" << e.cpu/1000.0
+				<< ",\"wait_us\":" << e.wait/1000.0
+				<< ",\"items\":" << e.items
+				<< ",\"bytes\":" << e.bytes
+				<< "}}";
+			}
+			os << "\n],\"displayTimeUnit\":\"ms\"}" << std::endl;
+			os.flags(flags);
+			os.precision(precision);
+		}
+
+		// one line per stage, most expensive first
+		void WriteSummary(std::ostream& os)
+		{
+			struct Total
+			{
+				std::size_t calls, items, bytes;
+				std::uint64_t wall, cpu, wait;
+			};
+
+			std::map<std::string, Total> totals;
+			for(const PipelineEvent& e : Events())
+			{
+				Total& t = totals[e.name];
+				t.calls++;
+				t.items += e.items;
+				t.bytes += e.bytes;
+				t.wall += e.wall;
+				t.cpu += e.cpu;
+				t.wait += e.wait;
+			}
+
+			std::ios::fmtflags flags = os.flags();
+			std::streamsize precision = os.precision();
+			std::vector< std::pair<std::string, Total> > rows(totals.begin(), totals.end());
+			std::sort(rows.begin(), rows.end(), [](const std::pair<std::string, Total>& a, const std::pair<std::string, Total>& b){ return a.second.wall > b.second.wall; });
+
+			os << std::left << std::setw(24) << "stage" << std::right
+			<< std::setw(8) << "calls"
+			<< std::setw(12) << "wall ms"
+			<< std::setw(12) << "cpu ms"
+			<< std::setw(12) << "wait ms"
+			<< std::setw(12) << "items"
+			<< std::setw(14) << "bytes"
+			<< std::setw(14) << "items/s"
+			<< std::endl;
+
+			for(const std::pair<std::string, Total>& row : rows)
+			{
+				const Total& t = row.second;
+				double seconds = t.wall/1e9;
+				os << std::left << std::setw(24) << row.first.substr(0,23) << std::right << std::fixed << std::setprecision(3)
+				<< std::setw(8) << t.calls
+				<< std::setw(12) << t.wall/1e6
+				<< std::setw(12) << t.cpu/1e6
+				<< std::setw(12) << t.wait/1e6
+				<< std::setw(12) << t.items
+				<< std::setw(14) << t.bytes
+				<< std::setw(14) << std::setprecision(0) << (seconds > 0 ? t.items/seconds : 0.0)
+				<< std::endl;
+			}
+			os.flags(flags);
+			os.precision(precision);
+		}
+
+	};
+
+}
+
+#ifdef PLIB_PIPELINE_PROFILING
+
+	#define PLIB_PROFILE_READY(readyTime) std::uint64_t readyTime = p::PipelineProfiler::Instance().Now()
+
+	#define PLIB_PROFILE_STARTED(node, readyTime) (node)->_queueWait = p::PipelineProfiler::Instance().Now() - (readyTime)
+
+	#define PLIB_PROFILE_BEGIN(event) \
+		p::PipelineEvent event; \
+		event.start = p::PipelineProfiler::Instance().Now(); \
+		event.cpu = p::PipelineProfiler::ThreadCpuNow()
+
+	#define PLIB_PROFILE_END(event, name_, wait_, items_, bytes_) \
+		event.wall = p::PipelineProfiler::Instance().Now() - event.start; \
+		event.cpu = p::PipelineProfiler::ThreadCpuNow() - event.cpu; \
+		event.wait = (wait_); \
+		event.name = (name_); \
+		event.items = (items_); \
+		event.bytes = (bytes_); \
+		p::PipelineProfiler::Instance().Record(event)
+
+#else
+
+	#define PLIB_PROFILE_READY(readyTime)
+	#define PLIB_PROFILE_STARTED(node, readyTime)
+	#define PLIB_PROFILE_BEGIN(event)
+	#define PLIB_PROFILE_END(event, name_, wait_, items_, bytes_)
+
+#endif
+
+#endif
@@ -0,0 +1,492 @@
+#include "Pipeline.hpp"
+
+#ifndef __processgroup__
+#define __processgroup__
+
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+/************************************* Plib process group ******************************************************
+Runs a subgraph of a Pipeline in a child process, for stages that are not thread safe or should not share
+the address space (leaking libraries, global state, crashes).
+
+p::ProcessGroup isolated("decoder");
+decoder->SetProcessGroup(&isolated);
+filter->SetProcessGroup(&isolated);
+sink->Update(); // decoder and filter run in a forked process, filter's output comes back to sink
+
+The group is scheduled as a single unit: it starts once every input from outside the group is calculated.
+The child sees the parent's memory as it was at fork time, so inputs never need to be sent.
+Outputs consumed outside the group are serialized with p::Serializer through a ring buffer in shared memory;
+trivially copyable payloads, and vectors or p::Arrays of them, are copied as raw blocks.
+Outputs only used inside the group never leave the child and are not marked as calculated.
+
+Groups have to be convex: no path may leave a group and come back into it.
+Stages of a group should not use OpenMP themselves, as its runtime does not survive fork.
+They may log and use p::parallel_for: the Logger and the ThreadPools are unlocked in the child, where pool
+loops and tasks run inline, on the child's only thread, and log records are written when it exits.
+TimerWheels do not survive fork: the child must not schedule timers.
+The child is killed as soon as the run is cancelled (see CancellationToken.hpp).
+Without fork (Windows) the group runs in process.
+***************************************************************************************************************/
+
+namespace p
+{
+
+	class PipelineProcessException : public std::exception
+	{
+	private:
+		std::string _what;
+	public:
+		PipelineProcessException(std::string group, std::string what)
+		:_what("Pipeline process group '"+group+"': "+what)
+		{}
+		virtual const char* what() const throw()
+		{
+			return _what.c_str();
+		}
+	};
+
+	// single producer single consumer byte ring, shared with the processes forked after its creation
+	class SharedRing
+	{
+	private:
+
+		struct Header
+		{
+			alignas(64) std::atomic<std::uint64_t> head; // bytes written, moved by the producer only
+			alignas(64) std::atomic<std::uint64_t> tail; // bytes read, moved by the consumer only
+		};
+
+		Header* _header;
+		char* _data;
+		std::size_t _capacity; // power of two
+		std::size_t _mapped;
+
+		static void Backoff(unsigned int& spins)
+		{
+			if( ++spins < 64 ) std::this_thread::yield();
+			else std::this_thread::sleep_for( std::chrono::microseconds(50) );
+		}
+
+	public:
+
+		SharedRing(std::size_t capacity)
+		{
+			_capacity = 4096;
+			while( _capacity < capacity ) _capacity <<= 1;
+			_mapped = sizeof(Header) + _capacity;
+
+			#ifndef _WIN32
+				void* memory = mmap(nullptr, _mapped, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+				if( memory == MAP_FAILED ) throw std::bad_alloc();
+			#else
+				void* memory = ::operator new(_mapped);
+			#endif
+			_header = new(memory) Header();
+			_data = static_cast<char*>(memory) + sizeof(Header);
+			Reset();
+		}
+
+		~SharedRing(void)
+		{
+			_header->~Header();
+			#ifndef _WIN32
+				munmap(_header, _mapped);
+			#else
+				::operator delete(_header);
+			#endif
+		}
+
+		SharedRing(const SharedRing&) = delete;
+		SharedRing& operator=(const SharedRing&) = delete;
+
+		// only while neither side is using the ring
+		void Reset(void)
+		{
+			_header->head.store(0);
+			_header->tail.store(0);
+		}
+
+		// blocks while the ring is full; returns false if alive() turns false before everything is written
+		template<class Alive>
+		bool Write(const char* s, std::size_t size, Alive alive)
+		{
+			std::uint64_t head = _header->head.load(std::memory_order_relaxed);
+			unsigned int spins = 0;
+
+			while( size )
+			{
+				std::size_t space = _capacity - (head - _header->tail.load(std::memory_order_acquire));
+				if( !space )
+				{
+					if( !alive() ) return false;
+					Backoff(spins);
+					continue;
+				}
+				spins = 0;
+
+				std::size_t n = std::min(space, size);
+				std::size_t offset = head & (_capacity-1);
+				std::size_t first = std::min(n, _capacity-offset);
+				std::memcpy(_data+offset, s, first);
+				std::memcpy(_data, s+first, n-first);
+
+				head += n;
+				s += n;
+				size -= n;
+				_header->head.store(head, std::memory_order_release);
+			}
+			return true;
+		}
+
+		// blocks while the ring is empty; reads less than size only once alive() is false and the ring drained
+		template<class Alive>
+		std::size_t Read(char* s, std::size_t size, Alive alive)
+		{
+			std::uint64_t tail = _header->tail.load(std::memory_order_relaxed);
+			std::size_t read = 0;
+			unsigned int spins = 0;
+
+			while( read < size )
+			{
+				std::size_t available = _header->head.load(std::memory_order_acquire) - tail;
+				if( !available )
+				{
+					// the writer may have written its last bytes just before leaving
+					if( !alive() && _header->head.load(std::memory_order_acquire) == tail ) break;
+					Backoff(spins);
+					continue;
+				}
+				spins = 0;
+
+				std::size_t n = std::min(available, size-read);
+				std::size_t offset = tail & (_capacity-1);
+				std::size_t first = std::min(n, _capacity-offset);
+				std::memcpy(s+read, _data+offset, first);
+				std::memcpy(s+read+first, _data, n-first);
+
+				tail += n;
+				read += n;
+				_header->tail.store(tail, std::memory_order_release);
+			}
+			return read;
+		}
+
+	};
+
+	// std::streambuf over a SharedRing: large writes and reads go straight to the ring
+	class RingBuffer : public std::streambuf
+	{
+	private:
+
+		SharedRing& _ring;
+		std::function<bool()> _alive;
+		char _buffer[4096];
+
+		bool Flush(void)
+		{
+			bool written = _ring.Write(pbase(), pptr()-pbase(), _alive);
+			setp(_buffer, _buffer+sizeof(_buffer));
+			return written;
+		}
+
+	protected:
+
+		int_type overflow(int_type c)
+		{
+			if( !Flush() ) return traits_type::eof();
+			if( !traits_type::eq_int_type(c, traits_type::eof()) )
+			{
+				*pptr() = traits_type::to_char_type(c);
+				pbump(1);
+			}
+			return traits_type::not_eof(c);
+		}
+
+		std::streamsize xsputn(const char* s, std::streamsize n)
+		{
+			if( n < epptr()-pptr() )
+			{
+				std::memcpy(pptr(), s, n);
+				pbump(n);
+				return n;
+			}
+			if( !Flush() || !_ring.Write(s, n, _alive) ) return 0;
+			return n;
+		}
+
+		int sync(void)
+		{
+			return Flush() ? 0 : -1;
+		}
+
+		int_type underflow(void)
+		{
+			std::size_t n = _ring.Read(_buffer, 1, _alive);
+			if( !n ) return traits_type::eof();
+			setg(_buffer, _buffer, _buffer+n);
+			return traits_type::to_int_type(_buffer[0]);
+		}
+
+		std::streamsize xsgetn(char* s, std::streamsize n)
+		{
+			std::streamsize buffered = std::min<std::streamsize>(n, egptr()-gptr());
+			std::memcpy(s, gptr(), buffered);
+			gbump(buffered);
+			return buffered + _ring.Read(s+buffered, n-buffered, _alive);
+		}
+
+	public:
+
+		// a RingBuffer is either written or read, never both
+		RingBuffer(SharedRing& ring, std::function<bool()> alive):_ring(ring),_alive(alive)
+		{
+			setp(_buffer, _buffer+sizeof(_buffer));
+			setg(_buffer, _buffer, _buffer);
+		}
+
+	};
+
+	class ProcessGroup
+	{
+
+	private:
+
+		enum : std::uint32_t { DONE = 0xFFFFFFFF, ERROR = 0xFFFFFFFE };
+
+		std::string _name;
+		SharedRing _ring;
+		std::mutex _mutex; // one child at a time per ring
+
+		static double Now(void)
+		{
+			return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		static void WriteTag(std::ostream& os, std::uint32_t tag)
+		{
+			os.write(reinterpret_cast<const char*>(&tag), sizeof(tag));
+		}
+
+		// runs the members in order, returns their Run times in ns
+		static std::vector<double> RunMembers(const std::vector<PipelineNode*>& members)
+		{
+			std::vector<double> costs;
+			CancellationToken group = CancellationToken::Current();
+			for(PipelineNode* node : members)
+			{
+				double start = Now();
+				node->GatherInputs();
+				CancellationToken::Current() = node->DeadlineToken(group);
+				node->Run();
+				CancellationToken::Current() = group;
+				costs.push_back( Now()-start );
+				node->CheckDeadline(costs.back());
+			}
+			return costs;
+		}
+
+		#ifndef _WIN32
+		void RunChild(const std::vector<PipelineNode*>& members, const std::vector<char>& exported, pid_t parent);
+		std::vector<double> ReadResults(const std::vector<PipelineNode*>& members, pid_t child);
+		static std::string Describe(int status);
+		#endif
+
+	public:
+
+		// ringCapacity bounds the memory shared with the child, not the size of the outputs
+		ProcessGroup(std::string name, std::size_t ringCapacity = 4<<20)
+		:_name(name), _ring(ringCapacity)
+		{}
+
+		const std::string& GetName(void) const
+		{
+			return _name;
+		}
+
+		// members in topological order; exported members have their outputs brought back and are marked calculated.
+		// returns the Run time of each member, in ns
+		std::vector<double> Run(const std::vector<PipelineNode*>& members, const std::vector<char>& exported);
+
+	};
+
+	inline std::vector<double> ProcessGroup::Run(const std::vector<PipelineNode*>& members, const std::vector<char>& exported)
+	{
+		for(std::size_t i=0; i<members.size(); i++)
+			if( exported[i] && !members[i]->CanTransferOutput() )
+				throw PipelineProcessException(_name, "output of '"+members[i]->GetName()+"' is used outside the group: specialize p::Serializer for it");
+
+		#ifdef _WIN32
+			return RunMembers(members);
+		#else
+			std::lock_guard<std::mutex> lock(_mutex);
+			_ring.Reset();
+
+			// buffered output would be written twice otherwise
+			std::cout.flush();
+			std::cerr.flush();
+			std::fflush(nullptr);
+
+			pid_t parent = getpid();
+			pid_t child = fork();
+			if( child < 0 ) throw PipelineProcessException(_name, std::string("fork failed: ")+std::strerror(errno));
+			if( child == 0 ) RunChild(members, exported, parent); // never returns
+
+			return ReadResults(members, child);
+		#endif
+	}
+
+	#ifndef _WIN32
+
+	inline void ProcessGroup::RunChild(const std::vector<PipelineNode*>& members, const std::vector<char>& exported, pid_t parent)
+	{
+		// a child left alone would block on a full ring forever
+		RingBuffer buffer(_ring, [parent]{ return getppid() == parent; });
+		std::ostream os(&buffer);
+		int status = EXIT_SUCCESS;
+
+		try
+		{
+			std::vector<double> costs = RunMembers(members);
+
+			for(std::size_t i=0; i<members.size(); i++)
+				if( exported[i] )
+				{
+					WriteTag(os, i);
+					members[i]->WriteOutput(os);
+				}
+
+			WriteTag(os, DONE);
+			os.write(reinterpret_cast<const char*>(costs.data()), costs.size()*sizeof(double));
+		}
+		catch(std::exception& e)
+		{
+			std::string what = e.what();
+			std::uint64_t length = what.size();
+			WriteTag(os, ERROR);
+			os.write(reinterpret_cast<const char*>(&length), sizeof(length));
+			os.write(what.data(), length);
+			status = EXIT_FAILURE;
+		}
+		catch(...)
+		{
+			WriteTag(os, ERROR);
+			std::uint64_t length = 0;
+			os.write(reinterpret_cast<const char*>(&length), sizeof(length));
+			status = EXIT_FAILURE;
+		}
+
+		os.flush();
+		// the child has no flusher thread
+		Logger::Instance().Flush();
+		std::cout.flush();
+		std::cerr.flush();
+		std::fflush(nullptr);
+		// no atexit handlers nor destructors of the parent's objects
+		_exit(status);
+	}
+
+	inline std::vector<double> ProcessGroup::ReadResults(const std::vector<PipelineNode*>& members, pid_t child)
+	{
+		int status = 0;
+		bool reaped = false, killed = false;
+		const CancellationToken& token = CancellationToken::Current();
+		RingBuffer buffer(_ring, [&]{
+			// the child cannot see the parent's token: it is stopped from here
+			if( !killed && token.IsCancelled() )
+			{
+				kill(child, SIGKILL);
+				killed = true;
+			}
+			if( !reaped && waitpid(child, &status, WNOHANG) == child ) reaped = true;
+			return !reaped;
+		});
+		std::istream is(&buffer);
+
+		std::vector<double> costs(members.size(), 0.0);
+		std::string error;
+		std::exception_ptr failure;
+		bool done = false;
+
+		try
+		{
+			while( !done && error.empty() )
+			{
+				std::uint32_t tag;
+				if( !is.read(reinterpret_cast<char*>(&tag), sizeof(tag)) ) break;
+
+				if( tag == DONE )
+					done = (bool)is.read(reinterpret_cast<char*>(costs.data()), costs.size()*sizeof(double));
+				else if( tag == ERROR )
+				{
+					std::uint64_t length = 0;
+					is.read(reinterpret_cast<char*>(&length), sizeof(length));
+					error.resize(length);
+					is.read(&error[0], length);
+					if( error.empty() ) error = "unknown exception";
+				}
+				else if( tag < members.size() )
+				{
+					members[tag]->ReadOutput(is);
+					members[tag]->_isCalculated = true;
+				}
+				else error = "corrupted output stream";
+			}
+		}
+		catch(const SerializationException& e)
+		{
+			// truncated output when the child died while writing it, the ring then being closed; malformed otherwise
+			if( !reaped ) error = std::string("corrupted output stream: ")+e.what();
+		}
+		catch(...)
+		{
+			// bad_alloc from a corrupted length, or anything thrown by ReadOutput: rethrown once the child is reaped
+			failure = std::current_exception();
+		}
+
+		// stopped reading early: the child may be blocked writing into the full ring
+		if( !reaped && !done ) kill(child, SIGKILL);
+		if( !reaped ) waitpid(child, &status, 0);
+
+		if( failure ) std::rethrow_exception(failure);
+
+		if( !error.empty() ) throw PipelineProcessException(_name, error);
+		if( !done && killed ) throw PipelineCancelledException( token.Reason() );
+		if( !done ) throw PipelineProcessException(_name, "child process "+Describe(status));
+
+		return costs;
+	}
+
+	inline std::string ProcessGroup::Describe(int status)
+	{
+		if( WIFSIGNALED(status) ) return "killed by signal "+std::to_string(WTERMSIG(status));
+		if( WIFEXITED(status) ) return "exited with code "+std::to_string(WEXITSTATUS(status));
+		return "stopped";
+	}
+
+	#endif
+
+}
+
+#endif
@@ -2,6 +2,34 @@
 #define __pbar__
 
 #include <iostream>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+
+/*
+Counter mode, for loops on one or several threads: workers bump an atomic counter, a background thread draws
+the bar at most every 'refresh', with throughput and estimated time left.
+
+ProgressBar bar(n);                               // starts drawing
+p::parallel_for(0, n, 0, [&](std::size_t i){ Work(i); bar.Tick(); });
+bar.Finish();                                     // last draw and newline; also done by the destructor
+
+[##########>---------]	5000/10000	(50%)	1.2e+04 it/s	ETA 00:00:04
+
+In very tight loops, Tick(chunk) once per chunk rather than once per item: the counter is shared by all threads.
+
+Pointer mode, as before: Progress() reads *i and *m and draws, from the looping thread only; it only writes
+when the bar or the percentage changes.
+ProgressBar bar(&i, &max);
+for(i=0; i<max; i++) { Work(i); bar.Progress(); }
+
+Formats are 4 or 5 characters: opening, done, [head,] left, closing; "[#>-]" by default.
+*/
 
 class ProgressBar
 {
@@ -10,68 +38,177 @@ class ProgressBar
 	int* _max;
 	int _size;
 	std::string _format;
+	int _drawn; // last percentage * (size+1) + filled width drawn by Progress, -1 before
 
-	public:
-	ProgressBar( int* i, int* m, std::string f="[#>-]", int s=50)
+	// counter mode
+	std::atomic<std::size_t> _done;
+	std::size_t _total;
+	std::ostream* _os;
+	std::chrono::steady_clock::duration _refresh;
+	std::chrono::steady_clock::time_point _start;
+	std::thread _renderer;
+	std::mutex _mutex;
+	std::condition_variable _wakeUp;
+	bool _finished;
+
+	static bool ValidFormat(std::string& f)
 	{
-		_current = i;
-		_max = m;
-		_size = s;
-		_format = f;
-		
-		if(f.length()!=4 && f.length()!=5) 
+		if(f.length()==4 || f.length()==5) return true;
+		std::cerr<<"ProgressBar::format\tInvalid format: length must be 4 or 5. Using default '[#>-]'"<<std::endl;
+		f="[#>-]";
+		return false;
+	}
+
+	std::string Bar(std::size_t iter, std::size_t maxIter) const
+	{
+		int l = _format.length()-1;
+		int scaledPercentage = maxIter ? (int)(_size*iter/maxIter) : _size;
+
+		std::string bar(1, _format[0]);
+		for(int i=0;i<=scaledPercentage-1;i++) bar += _format[1];
+		if(scaledPercentage < _size) bar += _format[l-2];
+		for(int i=scaledPercentage+1;i<_size;i++) bar += _format[l-1];
+		bar += _format[l];
+		return bar;
+	}
+
+	// hh:mm:ss
+	static std::string Duration(double seconds)
+	{
+		char buffer[32];
+		long s = (long)(seconds+0.5);
+		std::snprintf(buffer, sizeof(buffer), "%02ld:%02ld:%02ld", s/3600, s/60%60, s%60);
+		return buffer;
+	}
+
+	void Draw(std::size_t done, double rate)
+	{
+		if(done > _total) done = _total;
+		char stats[128];
+		std::snprintf(stats, sizeof(stats), "\t%zu/%zu\t(%d%%)\t%.3g it/s", done, _total, _total ? (int)(100*done/_total) : 100, rate);
+
+		std::string line = "\r" + Bar(done, _total) + stats;
+		if(done < _total) line += "\tETA " + (rate > 0 ? Duration((_total-done)/rate) : std::string("--:--:--"));
+		else line += "\t" + Duration(std::chrono::duration<double>(std::chrono::steady_clock::now()-_start).count());
+		// over the end of a longer previous line
+		*_os << line << "    " << std::flush;
+	}
+
+	// redraws every _refresh while the counter moves; throughput averaged over the last few seconds
+	void Render()
+	{
+		std::size_t previous = 0;
+		double rate = 0;
+		std::chrono::steady_clock::time_point last = _start;
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		while(!_finished)
 		{
-			std::cerr<<"ProgressBar::format\tInvalid format: length must be 4 or 5. Using default '[#>-]'"<<std::endl;
-			_format="[#-]";
+			_wakeUp.wait_for(lock, _refresh);
+			if(_finished) break;
+
+			std::size_t done = _done.load(std::memory_order_relaxed);
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			double elapsed = std::chrono::duration<double>(now-last).count();
+			if(elapsed <= 0) continue;
+
+			double instant = (done-previous)/elapsed;
+			double smoothing = std::min(1.0, elapsed/3.0);
+			rate = previous ? rate + smoothing*(instant-rate) : instant;
+			if(done != previous || !previous) Draw(done, rate);
+
+			previous = done;
+			last = now;
+			if(done >= _total) break;
 		}
 	}
-	
+
+	public:
+	ProgressBar( int* i, int* m, std::string f="[#>-]", int s=50)
+	:_current(i), _max(m), _size(s), _format(f), _drawn(-1), _done(0), _total(0), _os(&std::cout), _finished(true)
+	{
+		ValidFormat(_format);
+	}
+
+	// counter mode: Tick() to count, drawn on os every 'refresh' by a background thread
+	ProgressBar( std::size_t total, std::string f="[#>-]", int s=50, std::chrono::milliseconds refresh=std::chrono::milliseconds(100), std::ostream& os=std::cout)
+	:_current(nullptr), _max(nullptr), _size(s), _format(f), _drawn(-1), _done(0), _total(total), _os(&os),
+	_refresh(refresh), _start(std::chrono::steady_clock::now()), _finished(false)
+	{
+		ValidFormat(_format);
+		_renderer = std::thread(&ProgressBar::Render, this);
+	}
+
 	~ProgressBar()
 	{
+		Finish();
 		_current = nullptr;
 		_max = nullptr;
 	}
-	
+
+	ProgressBar(const ProgressBar&) = delete;
+	ProgressBar& operator=(const ProgressBar&) = delete;
+
 	void SetSize(int s)
 	{
 		_size = s;
 	}
-	
+
 	void SetFormat(std::string f)
 	{
-		if(f.length()!=4 && f.length()!=5) 
+		ValidFormat(f);
+		_format = f;
+	}
+
+	// from any thread; a relaxed atomic add
+	void Tick(std::size_t n = 1)
+	{
+		_done.fetch_add(n, std::memory_order_relaxed);
+	}
+
+	std::size_t Done() const
+	{
+		return _done.load(std::memory_order_relaxed);
+	}
+
+	// counter mode: stops the background thread, draws the final state and ends the line
+	void Finish()
+	{
 		{
-			std::cerr<<"ProgressBar::format\tInvalid format: length must be 4 or 5. Using default '[#>-]'"<<std::endl;
-			f="[#>-]";
+			std::lock_guard<std::mutex> lock(_mutex);
+			if(_finished && !_renderer.joinable()) return;
+			_finished = true;
 		}
-		
-		_format = f;
-		
+		_wakeUp.notify_one();
+		if(_renderer.joinable()) _renderer.join();
+
+		std::size_t done = _done.load();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-_start).count();
+		Draw(done, seconds > 0 ? done/seconds : 0);
+		*_os << std::endl;
 	}
-	
+
 	void Progress()
-	{		
+	{
 		int iter = *_current+1;
 		int maxIter = *_max;
-	
-		if(iter<=maxIter)
+
+		if(iter<=maxIter && maxIter>0)
 		{
-		
-			int l = _format.length()-1;
-			
 			int percentage = 100*iter/maxIter;
 			int scaledPercentage = _size*iter/maxIter;
-			
-			std::cout<<"\r"<<_format[0];
-			for(int i=0;i<=scaledPercentage-1;i++) std::cout<<_format[1];
-			std::cout<<_format[l-2];
-			for(int i=scaledPercentage+1;i<_size;i++) std::cout<<_format[l-1];
-			std::cout<<_format[l]<<"\t"<< iter <<"/"<<maxIter<<"\t("<<percentage<<"%)"<<std::flush;
-			
+
+			// nothing visible changed since the last call
+			int drawn = percentage*(_size+1) + scaledPercentage;
+			if(drawn == _drawn) return;
+			_drawn = drawn;
+
+			std::cout<<"\r"<<Bar(iter, maxIter)<<"\t"<< iter <<"/"<<maxIter<<"\t("<<percentage<<"%)"<<std::flush;
+
 			if(percentage==100)
 			std::cout<<std::endl;
 		}
-		
+
 	}
 
 
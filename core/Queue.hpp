@@ -0,0 +1,305 @@
+#ifndef __queue__
+#define __queue__
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <cstddef>
+
+/************************************* Plib lock-free queues ******************************************************
+Bounded queues passing values between threads without locks.
+
+p::SPSCQueue<Job> jobs(1024);    // one producer thread, one consumer thread
+p::MPMCQueue<Job> shared(4096);  // any number of both
+
+if( !jobs.TryPush(job) ) ...     // full: false, job untouched
+jobs.Push(job);                  // spins, then yields, until there is room
+Job j;
+if( jobs.TryPop(j) ) ...         // empty: false
+std::size_t n = jobs.TryPushBatch(batch, 64);   // pushes what fits, returns how many
+std::size_t m = jobs.TryPopBatch(out, 64);      // pops up to 64
+
+Capacities are rounded up to a power of two. Values have to be default constructible and movable; slots keep
+their moved-from values until reused. Head and tail indices sit on their own cache lines. The MPMC queue is
+Vyukov's bounded queue: a sequence number per slot tells producers and consumers whose turn it is, so a
+thread stalled between claiming and filling a slot only holds back the slots after it, never corrupts them.
+Pipeline stages can use them to stream elements to a concurrently running consumer.
+***************************************************************************************************************/
+
+namespace p
+{
+
+	namespace detail
+	{
+		const std::size_t CacheLine = 64;
+
+		inline std::size_t RoundUpPowerOfTwo(std::size_t n)
+		{
+			std::size_t c = 2;
+			while( c < n ) c <<= 1;
+			return c;
+		}
+
+		// busy waiting that gives the core away once it lasts
+		inline void Backoff(unsigned int& spins)
+		{
+			if( ++spins > 64 ) std::this_thread::yield();
+		}
+	}
+
+	template <typename T>
+	class SPSCQueue
+	{
+
+	private:
+
+		const std::size_t _mask;
+		std::unique_ptr<T[]> _slots;
+		char _padSlots[detail::CacheLine]; // read by both sides: away from the written indices
+
+		std::atomic<std::size_t> _tail;     // next slot to write, owned by the producer
+		std::size_t _cachedHead;            // producer's last view of _head
+		char _padTail[detail::CacheLine - sizeof(std::atomic<std::size_t>) - sizeof(std::size_t)];
+
+		std::atomic<std::size_t> _head;     // next slot to read, owned by the consumer
+		std::size_t _cachedTail;            // consumer's last view of _tail
+		char _padHead[detail::CacheLine - sizeof(std::atomic<std::size_t>) - sizeof(std::size_t)];
+
+
+	public:
+
+		SPSCQueue(std::size_t capacity)
+		:_mask(detail::RoundUpPowerOfTwo(capacity)-1), _slots(new T[_mask+1]), _tail(0), _cachedHead(0), _head(0), _cachedTail(0)
+		{}
+
+		SPSCQueue(const SPSCQueue&) = delete;
+		SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+		std::size_t Capacity(void) const
+		{
+			return _mask+1;
+		}
+
+		// exact from the producer or the consumer, approximate from other threads
+		std::size_t Size(void) const
+		{
+			return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+		}
+
+		// producer only
+		template<class U>
+		bool TryPush(U&& value)
+		{
+			std::size_t tail = _tail.load(std::memory_order_relaxed);
+			if( tail - _cachedHead > _mask )
+			{
+				_cachedHead = _head.load(std::memory_order_acquire);
+				if( tail - _cachedHead > _mask ) return false;
+			}
+			_slots[tail & _mask] = std::forward<U>(value);
+			_tail.store(tail+1, std::memory_order_release);
+			return true;
+		}
+
+		template<class U>
+		void Push(U&& value)
+		{
+			unsigned int spins = 0;
+			while( !TryPush(std::forward<U>(value)) ) detail::Backoff(spins);
+		}
+
+		// producer only: moves up to n values, in order, and publishes them at once
+		std::size_t TryPushBatch(T* values, std::size_t n)
+		{
+			std::size_t tail = _tail.load(std::memory_order_relaxed);
+			if( tail - _cachedHead + n > _mask+1 ) _cachedHead = _head.load(std::memory_order_acquire);
+			std::size_t room = _mask+1 - (tail - _cachedHead);
+			if( n > room ) n = room;
+
+			for(std::size_t i=0; i<n; i++) _slots[(tail+i) & _mask] = std::move(values[i]);
+			_tail.store(tail+n, std::memory_order_release);
+			return n;
+		}
+
+		// consumer only
+		bool TryPop(T& value)
+		{
+			std::size_t head = _head.load(std::memory_order_relaxed);
+			if( head == _cachedTail )
+			{
+				_cachedTail = _tail.load(std::memory_order_acquire);
+				if( head == _cachedTail ) return false;
+			}
+			value = std::move(_slots[head & _mask]);
+			_head.store(head+1, std::memory_order_release);
+			return true;
+		}
+
+		void Pop(T& value)
+		{
+			unsigned int spins = 0;
+			while( !TryPop(value) ) detail::Backoff(spins);
+		}
+
+		// consumer only: pops up to n values into values, in order
+		std::size_t TryPopBatch(T* values, std::size_t n)
+		{
+			std::size_t head = _head.load(std::memory_order_relaxed);
+			if( _cachedTail - head < n ) _cachedTail = _tail.load(std::memory_order_acquire);
+			std::size_t available = _cachedTail - head;
+			if( n > available ) n = available;
+
+			for(std::size_t i=0; i<n; i++) values[i] = std::move(_slots[(head+i) & _mask]);
+			_head.store(head+n, std::memory_order_release);
+			return n;
+		}
+
+	};
+
+	template <typename T>
+	class MPMCQueue
+	{
+
+	private:
+
+		struct Slot
+		{
+			std::atomic<std::size_t> sequence; // == position: free for the producer of position; == position+1: full
+			T value;
+		};
+
+		const std::size_t _mask;
+		std::unique_ptr<Slot[]> _slots;
+
+		char _padSlots[detail::CacheLine]; // read by every thread: away from the written indices
+		std::atomic<std::size_t> _tail;     // next position to claim for writing
+		char _padTail[detail::CacheLine - sizeof(std::atomic<std::size_t>)];
+		std::atomic<std::size_t> _head;     // next position to claim for reading
+		char _padHead[detail::CacheLine - sizeof(std::atomic<std::size_t>)];
+
+		// how many slots from position, up to n, are in the state wanted (offset 0: free, 1: full)
+		std::size_t Ready(std::size_t position, std::size_t n, std::size_t offset) const
+		{
+			std::size_t k = 0;
+			while( k < n && _slots[(position+k) & _mask].sequence.load(std::memory_order_acquire) == position+k+offset ) k++;
+			return k;
+		}
+
+		// claims up to n consecutive positions from index, offset as in Ready; returns the first one and sets n
+		std::size_t Claim(std::atomic<std::size_t>& index, std::size_t& n, std::size_t offset)
+		{
+			std::size_t position = index.load(std::memory_order_relaxed);
+			if( !n ) return position;
+			for(;;)
+			{
+				std::size_t ready = Ready(position, n, offset);
+				if( !ready )
+				{
+					// the slot is behind, or another thread claimed position in the meantime
+					std::size_t sequence = _slots[position & _mask].sequence.load(std::memory_order_acquire);
+					if( (std::ptrdiff_t)(sequence - (position+offset)) < 0 ) { n = 0; return position; }
+					position = index.load(std::memory_order_relaxed);
+					continue;
+				}
+				if( index.compare_exchange_weak(position, position+ready, std::memory_order_relaxed) )
+				{
+					n = ready;
+					return position;
+				}
+			}
+		}
+
+
+	public:
+
+		MPMCQueue(std::size_t capacity)
+		:_mask(detail::RoundUpPowerOfTwo(capacity)-1), _slots(new Slot[_mask+1]), _tail(0), _head(0)
+		{
+			for(std::size_t i=0; i<=_mask; i++) _slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+
+		MPMCQueue(const MPMCQueue&) = delete;
+		MPMCQueue& operator=(const MPMCQueue&) = delete;
+
+		std::size_t Capacity(void) const
+		{
+			return _mask+1;
+		}
+
+		// approximate while other threads push or pop
+		std::size_t Size(void) const
+		{
+			std::size_t tail = _tail.load(std::memory_order_acquire), head = _head.load(std::memory_order_acquire);
+			return tail > head ? tail - head : 0;
+		}
+
+		template<class U>
+		bool TryPush(U&& value)
+		{
+			std::size_t n = 1;
+			std::size_t position = Claim(_tail, n, 0);
+			if( !n ) return false;
+
+			Slot& slot = _slots[position & _mask];
+			slot.value = std::forward<U>(value);
+			slot.sequence.store(position+1, std::memory_order_release);
+			return true;
+		}
+
+		template<class U>
+		void Push(U&& value)
+		{
+			unsigned int spins = 0;
+			while( !TryPush(std::forward<U>(value)) ) detail::Backoff(spins);
+		}
+
+		// moves up to n values into consecutive slots, in order; returns how many
+		std::size_t TryPushBatch(T* values, std::size_t n)
+		{
+			std::size_t position = Claim(_tail, n, 0);
+			for(std::size_t i=0; i<n; i++)
+			{
+				Slot& slot = _slots[(position+i) & _mask];
+				slot.value = std::move(values[i]);
+				slot.sequence.store(position+i+1, std::memory_order_release);
+			}
+			return n;
+		}
+
+		bool TryPop(T& value)
+		{
+			std::size_t n = 1;
+			std::size_t position = Claim(_head, n, 1);
+			if( !n ) return false;
+
+			Slot& slot = _slots[position & _mask];
+			value = std::move(slot.value);
+			slot.sequence.store(position+_mask+1, std::memory_order_release);
+			return true;
+		}
+
+		void Pop(T& value)
+		{
+			unsigned int spins = 0;
+			while( !TryPop(value) ) detail::Backoff(spins);
+		}
+
+		// pops up to n consecutive values, in order; returns how many
+		std::size_t TryPopBatch(T* values, std::size_t n)
+		{
+			std::size_t position = Claim(_head, n, 1);
+			for(std::size_t i=0; i<n; i++)
+			{
+				Slot& slot = _slots[(position+i) & _mask];
+				values[i] = std::move(slot.value);
+				slot.sequence.store(position+i+_mask+1, std::memory_order_release);
+			}
+			return n;
+		}
+
+	};
+
+}
+
+#endif
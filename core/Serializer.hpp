@@ -0,0 +1,217 @@
+#ifndef __serializer__
+#define __serializer__
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <typeinfo>
+
+/************************************* Plib serialization ******************************************************
+Binary (de)serialization of Pipeline payloads, used to persist stage outputs on disk.
+
+std::ostringstream os;
+p::Serializer< std::vector<float> >::Write(os, features);
+std::istringstream is(os.str());
+p::Serializer< std::vector<float> >::Read(is, features);
+
+Trivially copyable types, std::string, std::vector and p::Array of serializable types are supported.
+Specialize p::Serializer<T> (supported, Write, Read, Size) for any other payload.
+Size is the payload's footprint in bytes, used for memory accounting.
+***************************************************************************************************************/
+
+namespace p
+{
+
+	class SerializationException : public std::runtime_error
+	{
+	public:
+		SerializationException(std::string what):std::runtime_error("Serialization: "+what)
+		{}
+	};
+
+	// unsupported type: usable in templates, fails at runtime only if actually called
+	template <typename T, typename Enable = void>
+	struct Serializer
+	{
+		static const bool supported = false;
+
+		static void Write(std::ostream&, const T&)
+		{
+			throw SerializationException(std::string("no Serializer for type ")+typeid(T).name());
+		}
+		static void Read(std::istream&, T&)
+		{
+			throw SerializationException(std::string("no Serializer for type ")+typeid(T).name());
+		}
+		static std::size_t Size(const T&)
+		{
+			return sizeof(T);
+		}
+	};
+
+	template <typename T>
+	struct Serializer<T, typename std::enable_if<std::is_trivially_copyable<T>::value>::type>
+	{
+		static const bool supported = true;
+
+		static void Write(std::ostream& os, const T& t)
+		{
+			os.write(reinterpret_cast<const char*>(&t), sizeof(T));
+		}
+		static void Read(std::istream& is, T& t)
+		{
+			if(!is.read(reinterpret_cast<char*>(&t), sizeof(T)))
+				throw SerializationException("truncated stream");
+		}
+		static std::size_t Size(const T&)
+		{
+			return sizeof(T);
+		}
+	};
+
+	template <>
+	struct Serializer<std::string>
+	{
+		static const bool supported = true;
+
+		static void Write(std::ostream& os, const std::string& s)
+		{
+			std::uint64_t size = s.size();
+			os.write(reinterpret_cast<const char*>(&size), sizeof(size));
+			os.write(s.data(), s.size());
+		}
+		static void Read(std::istream& is, std::string& s)
+		{
+			std::uint64_t size = 0;
+			if(!is.read(reinterpret_cast<char*>(&size), sizeof(size)))
+				throw SerializationException("truncated stream");
+			s.resize(size);
+			if(size && !is.read(&s[0], size))
+				throw SerializationException("truncated stream");
+		}
+		static std::size_t Size(const std::string& s)
+		{
+			return sizeof(std::string) + s.capacity();
+		}
+	};
+
+	template <typename T, typename A>
+	struct Serializer< std::vector<T,A> >
+	{
+		static const bool supported = Serializer<T>::supported;
+
+		static void Write(std::ostream& os, const std::vector<T,A>& v)
+		{
+			std::uint64_t size = v.size();
+			os.write(reinterpret_cast<const char*>(&size), sizeof(size));
+			for(const T& t : v) Serializer<T>::Write(os, t);
+		}
+		static void Read(std::istream& is, std::vector<T,A>& v)
+		{
+			std::uint64_t size = 0;
+			if(!is.read(reinterpret_cast<char*>(&size), sizeof(size)))
+				throw SerializationException("truncated stream");
+			v.resize(size);
+			for(T& t : v) Serializer<T>::Read(is, t);
+		}
+		static std::size_t Size(const std::vector<T,A>& v)
+		{
+			std::size_t size = sizeof(std::vector<T,A>) + (v.capacity()-v.size())*sizeof(T);
+			for(const T& t : v) size += Serializer<T>::Size(t);
+			return size;
+		}
+	};
+
+	template <typename T> class Array;
+
+	// dimensions, then the flattened data in a single block when elements are trivially copyable
+	template <typename T>
+	struct Serializer< Array<T> >
+	{
+		static const bool supported = Serializer<T>::supported;
+
+		static void Write(std::ostream& os, const Array<T>& a)
+		{
+			std::uint32_t dim = a.dimension();
+			os.write(reinterpret_cast<const char*>(&dim), sizeof(dim));
+			for(std::uint32_t i=0; i<dim; i++)
+			{
+				std::uint32_t size = a.size(i);
+				os.write(reinterpret_cast<const char*>(&size), sizeof(size));
+			}
+
+			if(std::is_trivially_copyable<T>::value)
+				os.write(reinterpret_cast<const char*>(a.data()), sizeof(T)*a.length());
+			else
+				for(unsigned int i=0; i<a.length(); i++) Serializer<T>::Write(os, a.data()[i]);
+		}
+		static void Read(std::istream& is, Array<T>& a)
+		{
+			std::uint32_t dim = 0;
+			if(!is.read(reinterpret_cast<char*>(&dim), sizeof(dim)))
+				throw SerializationException("truncated stream");
+			std::vector<unsigned int> size(dim);
+			for(std::uint32_t i=0; i<dim; i++)
+			{
+				std::uint32_t s = 0;
+				if(!is.read(reinterpret_cast<char*>(&s), sizeof(s)))
+					throw SerializationException("truncated stream");
+				size[i] = s;
+			}
+			a.Create(dim, size.data());
+
+			if(std::is_trivially_copyable<T>::value)
+			{
+				if(!is.read(reinterpret_cast<char*>(a.data()), sizeof(T)*a.length()))
+					throw SerializationException("truncated stream");
+			}
+			else
+				for(unsigned int i=0; i<a.length(); i++) Serializer<T>::Read(is, a.data()[i]);
+		}
+		static std::size_t Size(const Array<T>& a)
+		{
+			return sizeof(Array<T>) + a.dimension()*sizeof(unsigned int) + a.length()*sizeof(T);
+		}
+	};
+
+	// 64 bits FNV-1a, cheap and stable across runs (std::hash is not required to be)
+	class Hasher
+	{
+	private:
+		std::uint64_t _state;
+
+	public:
+		Hasher():_state(14695981039346656037ULL)
+		{}
+
+		Hasher& Add(const void* data, std::size_t size)
+		{
+			const unsigned char* bytes = static_cast<const unsigned char*>(data);
+			for(std::size_t i=0; i<size; i++)
+			{
+				_state ^= bytes[i];
+				_state *= 1099511628211ULL;
+			}
+			return *this;
+		}
+
+		Hasher& Add(const std::string& s)
+		{
+			// length prefix so that ("ab","c") and ("a","bc") differ
+			std::uint64_t size = s.size();
+			Add(&size, sizeof(size));
+			return Add(s.data(), s.size());
+		}
+
+		std::uint64_t Value(void) const
+		{
+			return _state;
+		}
+	};
+
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef __span__
+#define __span__
+
+#include <cstddef>
+
+namespace p
+{
+	/**
+	 Non owning view over a contiguous range of elements
+	 */
+	template <typename T>
+	class Span
+	{
+	private:
+		T* _data;
+		std::size_t _size;
+
+	public:
+		Span(void):_data(nullptr),_size(0)
+		{}
+
+		Span(T* data, std::size_t size):_data(data),_size(size)
+		{}
+
+		T* begin(void) const { return _data; }
+		T* end(void) const { return _data+_size; }
+		T* data(void) const { return _data; }
+		std::size_t size(void) const { return _size; }
+		bool empty(void) const { return _size == 0; }
+
+		T& operator[](std::size_t i) const
+		{
+			return _data[i];
+		}
+
+		/**
+		 returns the view of [offset, offset+count[, clamped to the end of the Span
+		 */
+		Span Subspan(std::size_t offset, std::size_t count) const
+		{
+			if(offset > _size) offset = _size;
+			if(count > _size-offset) count = _size-offset;
+			return Span(_data+offset, count);
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,290 @@
+#ifndef __sync__
+#define __sync__
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <type_traits>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+/************************************* Plib synchronization ******************************************************
+Locks and rendezvous points that spin briefly, yield, then sleep in the kernel (futex) until woken.
+
+p::Mutex m;                                   // std::lock_guard / std::unique_lock compatible
+std::lock_guard<p::Mutex> lock(m);
+
+p::Barrier epoch(workers);                    // reusable
+for(...) { TrainShard(w); if( epoch.ArriveAndWait() ) MergeWeights(); }   // true on one thread per phase
+
+p::Latch loaded(files);                       // single use
+loaded.CountDown();                           // from each loader
+loaded.Wait();
+
+p::SeqLock<Stats> stats;                      // trivially copyable values, many readers, rare writers
+stats.Store(s);                               // writers never wait for readers
+Stats now = stats.Load();                     // readers retry while a write is in progress
+
+The mutex is not fair. It adapts its spin count to how long the lock was held recently: spinning is
+cut short for locks held longer than a context switch. Without futexes (not Linux) sleeping is a yield.
+***************************************************************************************************************/
+
+namespace p
+{
+
+	namespace detail
+	{
+		// tells the core this is a spin loop: saves power, and the sibling hyperthread gets the pipeline
+		inline void CpuRelax(void)
+		{
+			#if defined(__x86_64__) || defined(__i386__)
+				__builtin_ia32_pause();
+			#elif defined(__aarch64__)
+				asm volatile("yield");
+			#endif
+		}
+
+		static_assert(sizeof(std::atomic<int>) == sizeof(int), "futexes need plain int atomics");
+
+		// sleeps while *address == expected; may return spuriously
+		inline void FutexWait(std::atomic<int>& address, int expected)
+		{
+			#ifdef __linux__
+				syscall(SYS_futex, reinterpret_cast<int*>(&address), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+			#else
+				if( address.load(std::memory_order_relaxed) == expected ) std::this_thread::yield();
+			#endif
+		}
+
+		inline void FutexWake(std::atomic<int>& address, int count)
+		{
+			#ifdef __linux__
+				syscall(SYS_futex, reinterpret_cast<int*>(&address), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+			#else
+				(void)address; (void)count;
+			#endif
+		}
+
+		// spins a while for address to leave 'value', then sleeps until it does, counted in sleepers
+		inline void WaitWhileEqual(std::atomic<int>& address, int value, std::atomic<int>& sleepers)
+		{
+			// the thread to wait for is likely running on another core, or runnable on this one
+			for(unsigned int s=0; s<64; s++)
+			{
+				if( address.load(std::memory_order_acquire) != value ) return;
+				if( s < 16 ) CpuRelax();
+				else std::this_thread::yield();
+			}
+			sleepers.fetch_add(1);
+			while( address.load() == value ) FutexWait(address, value);
+			sleepers.fetch_sub(1);
+		}
+
+		// after a seq_cst store to address: wakes the threads sleeping in WaitWhileEqual, if any
+		inline void WakeSleepers(std::atomic<int>& address, std::atomic<int>& sleepers)
+		{
+			if( sleepers.load() ) FutexWake(address, INT_MAX);
+		}
+	}
+
+	class Mutex
+	{
+
+	private:
+
+		enum { UNLOCKED = 0, LOCKED = 1, CONTENDED = 2 }; // CONTENDED: someone may be sleeping
+		static const int MaxSpins = 1000;
+
+		std::atomic<int> _state;
+		std::atomic<int> _spins; // current spin budget, a running average of the spins that paid off
+
+
+	public:
+
+		Mutex(void):_state(UNLOCKED), _spins(50)
+		{}
+
+		Mutex(const Mutex&) = delete;
+		Mutex& operator=(const Mutex&) = delete;
+
+		bool try_lock(void)
+		{
+			int expected = UNLOCKED;
+			return _state.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire, std::memory_order_relaxed);
+		}
+
+		void lock(void)
+		{
+			if( try_lock() ) return;
+
+			int budget = _spins.load(std::memory_order_relaxed);
+			for(int s=0; s<budget; s++)
+			{
+				detail::CpuRelax();
+				if( _state.load(std::memory_order_relaxed) == UNLOCKED && try_lock() )
+				{
+					_spins.store(std::min(budget + (s + s/4 + 8 - budget)/8, (int)MaxSpins), std::memory_order_relaxed);
+					return;
+				}
+			}
+			// spinning did not pay: spin less next time
+			_spins.store(std::max(budget - budget/8 - 1, 1), std::memory_order_relaxed);
+
+			while( _state.exchange(CONTENDED, std::memory_order_acquire) != UNLOCKED )
+				detail::FutexWait(_state, CONTENDED);
+		}
+
+		void unlock(void)
+		{
+			if( _state.exchange(UNLOCKED, std::memory_order_release) == CONTENDED )
+				detail::FutexWake(_state, 1);
+		}
+
+	};
+
+	class Barrier
+	{
+
+	private:
+
+		const int _threads;
+		std::atomic<int> _remaining;
+		std::atomic<int> _sense; // flipped by the last thread of each phase
+		std::atomic<int> _sleepers;
+
+
+	public:
+
+		Barrier(unsigned int threads):_threads(threads), _remaining(threads), _sense(0), _sleepers(0)
+		{}
+
+		Barrier(const Barrier&) = delete;
+		Barrier& operator=(const Barrier&) = delete;
+
+		// blocks until every thread arrived; returns true on exactly one of them, once the others may leave
+		bool ArriveAndWait(void)
+		{
+			int sense = _sense.load(std::memory_order_acquire);
+			if( _remaining.fetch_sub(1, std::memory_order_acq_rel) == 1 )
+			{
+				_remaining.store(_threads, std::memory_order_relaxed);
+				_sense.store(!sense);
+				detail::WakeSleepers(_sense, _sleepers);
+				return true;
+			}
+			detail::WaitWhileEqual(_sense, sense, _sleepers);
+			return false;
+		}
+
+		unsigned int Threads(void) const
+		{
+			return _threads;
+		}
+
+	};
+
+	class Latch
+	{
+
+	private:
+
+		std::atomic<int> _count;
+		std::atomic<int> _sleepers;
+
+
+	public:
+
+		Latch(unsigned int count):_count(count), _sleepers(0)
+		{}
+
+		Latch(const Latch&) = delete;
+		Latch& operator=(const Latch&) = delete;
+
+		// counting down past zero opens the latch as well
+		void CountDown(unsigned int n = 1)
+		{
+			int previous = _count.fetch_sub(n);
+			if( previous > 0 && previous <= (int)n ) detail::WakeSleepers(_count, _sleepers);
+		}
+
+		bool TryWait(void) const
+		{
+			return _count.load(std::memory_order_acquire) <= 0;
+		}
+
+		void Wait(void)
+		{
+			int count;
+			while( (count = _count.load(std::memory_order_acquire)) > 0 ) detail::WaitWhileEqual(_count, count, _sleepers);
+		}
+
+		void ArriveAndWait(unsigned int n = 1)
+		{
+			CountDown(n);
+			Wait();
+		}
+
+	};
+
+	template <typename T>
+	class SeqLock
+	{
+
+		static_assert(std::is_trivially_copyable<T>::value, "SeqLock values are copied while being written");
+
+	private:
+
+		std::atomic<unsigned int> _sequence; // odd while a write is in progress
+		Mutex _writers;
+		T _value;
+
+
+	public:
+
+		SeqLock(const T& value = T()):_sequence(0), _value(value)
+		{}
+
+		SeqLock(const SeqLock&) = delete;
+		SeqLock& operator=(const SeqLock&) = delete;
+
+		void Store(const T& value)
+		{
+			std::lock_guard<Mutex> lock(_writers);
+			unsigned int sequence = _sequence.load(std::memory_order_relaxed);
+			_sequence.store(sequence+1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			std::memcpy(&_value, &value, sizeof(T));
+			_sequence.store(sequence+2, std::memory_order_release);
+		}
+
+		T Load(void) const
+		{
+			T value;
+			for(unsigned int spins=0;; spins++)
+			{
+				unsigned int before = _sequence.load(std::memory_order_acquire);
+				if( before & 1 )
+				{
+					// the writer may have been preempted mid-write
+					if( spins > 100 ) std::this_thread::yield();
+					else detail::CpuRelax();
+					continue;
+				}
+				std::memcpy(&value, &_value, sizeof(T));
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if( _sequence.load(std::memory_order_relaxed) == before ) return value;
+			}
+		}
+
+	};
+
+}
+
+#endif
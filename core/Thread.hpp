@@ -2,55 +2,882 @@
 #define __thread__
 
 #include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <future>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <thread>
 #include <chrono>
+#include <utility>
+#include <exception>
+#include <cstring>
+#include <cstdint>
+
+#include "Logger.hpp"
+#include "CpuTopology.hpp"
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
 
 /************************************* Optimal Plib threads ******************************************************
 p::Thread updateDensityThread([&] {diffuse(0, _density0, _density, _diff); });
 p::Thread advectVelocityXThread([&] {advect(1, _Vx, _Vx0, _Vx0, _Vy0); });
-advectVelocityXThread.join();
-updateDensityThread.join();
+advectVelocityXThread.Join();
+updateDensityThread.Join();
+
+Persistent workers, for many short tasks:
+std::future<double> f = p::ThreadPool::Instance().Submit([](double x){ return std::sqrt(x); }, 2.0);
+p::ThreadPool::Instance().Post([&]{ counter++; });     // no future, cheaper
+p::ThreadPool::Instance().Wait();                       // until no task is left, running some meanwhile
+double root = f.get();                                  // rethrows what the task threw
+
+Loops, split over the shared pool and the calling thread:
+p::parallel_for(0, n, 1024, [&](std::size_t i){ y[i] = a*x[i] + y[i]; });
+double sum = p::parallel_reduce(0, n, 1024, 0.0, [&](std::size_t i){ return x[i]; }, std::plus<double>());
+
+Tasks beyond the number of workers are queued, never dropped. Each worker has its own queue: tasks submitted
+from a worker go to the front of its queue, others are spread over the workers; idle workers steal from the back
+of the others' queues. In strict mode, a p::Thread that would exceed the optimum number of threads runs on
+the shared pool instead of a new thread.
+
+Placement, on machines with several NUMA nodes (see CpuTopology.hpp):
+p::Thread pinned(fn, p::CpuTopology::Instance().Cpus(1));  // runs on node 1's CPUs only
+p::ThreadPool pool(0, p::ThreadPool::NUMA_NODES);           // workers spread over nodes, stealing within their node first
+double* x = static_cast<double*>(std::malloc(n*sizeof(double)));
+pool.FirstTouch(x, n*sizeof(double));                      // each worker's share of x allocated on its node
+
+Statistics, per worker: tasks run and stolen always; busy, idle and blocked times with -DPLIB_THREAD_STATS.
+p::ThreadPool::Statistics stats = pool.GetStatistics();
+std::cout << stats.Total().busy / (stats.seconds * pool.Size());          // utilization
+p::TimerWheel::Instance().Every(std::chrono::seconds(10), [&]{ pool.LogStatistics(); });
+Busy time leaves out the time blocked, which is spent waiting for a queue lock, or in Wait from a task.
+
+fork is safe: the pools' locks are taken around it, so the child finds them free. The workers do not survive
+in the child: there, parallel_for, parallel_reduce, RunOnEach and submitted tasks run inline on the calling
+thread, and Wait is not to be used.
 ***************************************************************************************************************/
 
 namespace p
 {
 
-	class Thread
+	class ThreadPool
 	{
+
+	public:
+
+		// where workers run: anywhere, one per CPU, or anywhere on a NUMA node with workers split over nodes
+		enum Placement { FLOATING, CORES, NUMA_NODES };
+
+		// times in seconds, 0 without PLIB_THREAD_STATS
+		struct WorkerStatistics
+		{
+			std::uint64_t tasks;  // run by the worker, stolen ones included
+			std::uint64_t steals; // taken from another worker's queue
+			double busy, idle, blocked;
+		};
+
+		struct Statistics
+		{
+			double seconds;       // since the pool was created, or the statistics reset
+			std::size_t queued, unfinished;
+			std::vector<WorkerStatistics> workers;
+
+			WorkerStatistics Total(void) const
+			{
+				WorkerStatistics total = {0, 0, 0, 0, 0};
+				for(const WorkerStatistics& w : workers)
+				{
+					total.tasks += w.tasks;
+					total.steals += w.steals;
+					total.busy += w.busy;
+					total.idle += w.idle;
+					total.blocked += w.blocked;
+				}
+				return total;
+			}
+		};
+
+
 	private:
 
-		static const unsigned short _optimumMaxThreads;
-		static unsigned short _currentThreadsInUse;
-		static bool _strict;
+		// move-only type erased callable, cheaper than std::function around a packaged_task
+		class Task
+		{
+		private:
+			struct Base
+			{
+				virtual ~Base(void) {}
+				virtual void Run(void) = 0;
+			};
+			template<class F>
+			struct Callable : Base
+			{
+				F f;
+				Callable(F&& c):f(std::move(c)) {}
+				void Run(void) { f(); }
+			};
+			std::unique_ptr<Base> _f;
+		public:
+			Task(void) {}
+			template<class F>
+			Task(F f):_f(new Callable<F>(std::move(f))) {}
+			void operator()(void) { _f->Run(); }
+		};
+
+		struct Worker
+		{
+			std::mutex mutex;
+			std::deque<Task> tasks;
+			std::deque<Task> own;     // for this worker only, never stolen
+			std::atomic<std::size_t> owned; // tasks in own, left out of _queued: no other worker may wake up for them
+			int node, cpu;            // -1 when not pinned
+			std::vector<int> victims; // queues to steal from, same node first
+
+			// written by the worker only; times in ns, 0 without PLIB_THREAD_STATS
+			std::atomic<std::uint64_t> executed, stolen, busy, idle, blocked;
+			std::atomic<std::uint64_t> sleepingSince; // 0 while awake
+
+			Worker(void):owned(0),node(-1),cpu(-1),executed(0),stolen(0),busy(0),idle(0),blocked(0),sleepingSince(0)
+			{}
+		};
+
+		std::vector< std::unique_ptr<Worker> > _queues;
+		std::vector<std::thread> _threads;
+
+		std::atomic<std::size_t> _queued;     // in the queues
+		std::atomic<std::size_t> _unfinished; // queued or running
+		std::atomic<unsigned int> _sleeping;
+		std::atomic<std::size_t> _waiting;    // tasks blocked in Wait
+		std::atomic<unsigned int> _next;      // round robin of outside submissions
+		bool _stop;
+		bool _forked; // in a child forked from the pool's process: no worker left
+		std::mutex _sleepMutex;
+		std::condition_variable _wakeUp, _finished;
+		Placement _placement;
+		std::chrono::steady_clock::time_point _statisticsStart;
+
+		static std::uint64_t Clock(void)
+		{
+			#ifdef PLIB_THREAD_STATS
+				return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+			#else
+				return 0;
+			#endif
+		}
+
+		// the calling thread's Worker, nullptr for threads outside the pool
+		Worker* Self(void)
+		{
+			return IsWorker() ? _queues[CurrentWorker()].get() : nullptr;
+		}
+
+		// locks m, counting the time it was held by others as the calling worker's blocked time
+		static void Lock(std::mutex& m, Worker* self)
+		{
+			#ifdef PLIB_THREAD_STATS
+				if( self && m.try_lock() ) return;
+				std::uint64_t start = Clock();
+				m.lock();
+				if( self ) self->blocked.fetch_add(Clock()-start, std::memory_order_relaxed);
+			#else
+				(void)self;
+				m.lock();
+			#endif
+		}
+
+		// tasks of this pool running on the calling thread, nested in Waits
+		static unsigned int& Depth(void)
+		{
+			static thread_local unsigned int depth = 0;
+			return depth;
+		}
+
+		// pools alive in the process, locked around fork
+		struct Registry
+		{
+			std::mutex mutex;
+			std::vector<ThreadPool*> pools;
+		};
+
+		// never destroyed: pools may be destroyed after static destruction began
+		static Registry& Pools(void)
+		{
+			static Registry* registry = CreateRegistry();
+			return *registry;
+		}
+
+		static Registry* CreateRegistry(void)
+		{
+			Registry* registry = new Registry;
+			#ifndef _WIN32
+				pthread_atfork(&BeforeFork, &AfterForkInParent, &AfterForkInChild);
+			#endif
+			return registry;
+		}
+
+		// the forking thread holds every lock, so that no other thread holds one in the child
+		static void BeforeFork(void)
+		{
+			Registry& registry = Pools();
+			registry.mutex.lock();
+			for(ThreadPool* pool : registry.pools)
+			{
+				pool->_sleepMutex.lock();
+				for(std::unique_ptr<Worker>& w : pool->_queues) w->mutex.lock();
+			}
+		}
+
+		static void AfterForkInParent(void)
+		{
+			Registry& registry = Pools();
+			for(ThreadPool* pool : registry.pools)
+			{
+				for(std::unique_ptr<Worker>& w : pool->_queues) w->mutex.unlock();
+				pool->_sleepMutex.unlock();
+			}
+			registry.mutex.unlock();
+		}
+
+		static void AfterForkInChild(void)
+		{
+			AfterForkInParent();
+			for(ThreadPool* pool : Pools().pools) pool->_forked = true;
+		}
+
+		void Push(Task task)
+		{
+			Worker* self = Self();
+			_unfinished.fetch_add(1);
+			if( _forked )
+			{
+				Execute(task);
+				return;
+			}
+			if( self )
+			{
+				Lock(self->mutex, self);
+				std::lock_guard<std::mutex> lock(self->mutex, std::adopt_lock);
+				self->tasks.push_front(std::move(task));
+				_queued.fetch_add(1);
+			}
+			else
+			{
+				Worker& w = *_queues[ _next.fetch_add(1, std::memory_order_relaxed) % _queues.size() ];
+				std::lock_guard<std::mutex> lock(w.mutex);
+				w.tasks.push_back(std::move(task));
+				_queued.fetch_add(1);
+			}
+
+			// _queued raised before reading _sleeping, the sleeper does the opposite: one of them sees the other
+			if( _sleeping.load() )
+			{
+				std::lock_guard<std::mutex> lock(_sleepMutex);
+				_wakeUp.notify_one();
+			}
+		}
+
+		// own queues from the front, then the others' from the back
+		bool Pop(int self, Task& task)
+		{
+			Worker* me = self >= 0 ? _queues[self].get() : nullptr;
+			if( !_queued.load(std::memory_order_relaxed) && !(me && me->owned.load(std::memory_order_relaxed)) ) return false;
+
+			if( me )
+			{
+				Worker& w = *me;
+				Lock(w.mutex, me);
+				std::lock_guard<std::mutex> lock(w.mutex, std::adopt_lock);
+				if( !w.own.empty() )
+				{
+					task = std::move(w.own.front());
+					w.own.pop_front();
+					w.owned.fetch_sub(1);
+					return true;
+				}
+				if( !w.tasks.empty() )
+				{
+					task = std::move(w.tasks.front());
+					w.tasks.pop_front();
+					_queued.fetch_sub(1);
+					return true;
+				}
+			}
+
+			const std::vector<int>& victims = _queues[self >= 0 ? self : 0]->victims;
+			for(std::size_t k=0; k<victims.size(); k++)
+			{
+				if( victims[k] == self ) continue;
+				Worker& w = *_queues[victims[k]];
+				Lock(w.mutex, me);
+				std::lock_guard<std::mutex> lock(w.mutex, std::adopt_lock);
+				if( w.tasks.empty() ) continue;
+
+				task = std::move(w.tasks.back());
+				w.tasks.pop_back();
+				_queued.fetch_sub(1);
+				if( me ) me->stolen.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+			return false;
+		}
+
+		// worker k's node and CPU, and the order it steals in
+		void Place(void)
+		{
+			const CpuTopology& topology = CpuTopology::Instance();
+			std::size_t n = _queues.size();
+
+			std::vector<int> cpus; // node by node
+			for(unsigned int node=0; node<topology.Nodes(); node++)
+				cpus.insert(cpus.end(), topology.Cpus(node).begin(), topology.Cpus(node).end());
+
+			for(std::size_t k=0; k<n; k++)
+			{
+				Worker& w = *_queues[k];
+				w.node = w.cpu = -1;
+				// contiguous blocks of workers per node, sized like the nodes
+				int cpu = cpus[k*cpus.size()/n];
+				if( _placement == CORES ) w.cpu = cpus[k % cpus.size()];
+				if( _placement != FLOATING ) w.node = topology.NodeOf( _placement == CORES ? w.cpu : cpu );
+			}
+
+			for(std::size_t k=0; k<n; k++)
+			{
+				std::vector<int>& victims = _queues[k]->victims;
+				victims.clear();
+				for(int same=1; same>=0; same--)
+					for(std::size_t j=1; j<=n; j++)
+					{
+						std::size_t v = (k+j) % n;
+						if( (_queues[v]->node == _queues[k]->node) == (bool)same ) victims.push_back(v);
+					}
+			}
+		}
+
+		void Execute(Task& task)
+		{
+			// nested tasks are part of the busy time of the one they run in
+			Worker* self = Self();
+			bool outermost = self && !Depth();
+			std::uint64_t start = 0, blocked = 0;
+			if( outermost )
+			{
+				start = Clock();
+				blocked = self->blocked.load(std::memory_order_relaxed);
+			}
+
+			Depth()++;
+			try
+			{
+				task();
+			}
+			catch(const std::exception& e)
+			{
+				PLIB_LOG_ERROR("posted task failed").Field("error", e.what());
+			}
+			catch(...)
+			{
+				PLIB_LOG_ERROR("posted task failed");
+			}
+			task = Task();
+			Depth()--;
+
+			if( self ) self->executed.fetch_add(1, std::memory_order_relaxed);
+			if( outermost ) self->busy.fetch_add(Clock() - start - (self->blocked.load(std::memory_order_relaxed) - blocked), std::memory_order_relaxed);
+
+			if( _unfinished.fetch_sub(1) == 1 )
+			{
+				std::lock_guard<std::mutex> lock(_sleepMutex);
+				_finished.notify_all();
+			}
+		}
+
+		void Work(int self)
+		{
+			CurrentPool() = this;
+			CurrentWorker() = self;
+
+			Worker& w = *_queues[self];
+			if( w.cpu >= 0 ) CpuTopology::PinCurrentThread(w.cpu);
+			else if( w.node >= 0 ) CpuTopology::PinCurrentThreadToNode(w.node);
+
+			Task task;
+			for(;;)
+			{
+				if( Pop(self, task) )
+				{
+					Execute(task);
+					continue;
+				}
+
+				std::uint64_t start = Clock();
+				w.sleepingSince.store(start, std::memory_order_relaxed);
+				std::unique_lock<std::mutex> lock(_sleepMutex);
+				_sleeping.fetch_add(1);
+				_wakeUp.wait(lock, [this, &w]{ return _stop || _queued.load() > 0 || w.owned.load() > 0; });
+				_sleeping.fetch_sub(1);
+				w.sleepingSince.store(0, std::memory_order_relaxed);
+				w.idle.fetch_add(Clock()-start, std::memory_order_relaxed);
+				if( _stop && !_queued.load() && !w.owned.load() ) break;
+			}
+		}
+
+		static const ThreadPool*& CurrentPool(void)
+		{
+			static thread_local const ThreadPool* pool = nullptr;
+			return pool;
+		}
+
+
+	public:
+
+		// threads = 0 uses one thread per core
+		ThreadPool(unsigned int threads = 0, Placement placement = FLOATING)
+		:_queued(0),_unfinished(0),_sleeping(0),_waiting(0),_next(0),_stop(false),_forked(false),_placement(placement),
+		_statisticsStart(std::chrono::steady_clock::now())
+		{
+			if( !threads ) threads = std::max(1u, std::thread::hardware_concurrency());
+			for(unsigned int i=0; i<threads; i++) _queues.push_back( std::unique_ptr<Worker>(new Worker) );
+			Place();
+			for(unsigned int i=0; i<threads; i++) _threads.push_back( std::thread(&ThreadPool::Work, this, (int)i) );
+
+			std::lock_guard<std::mutex> lock(Pools().mutex);
+			Pools().pools.push_back(this);
+		}
+
+		// runs every queued task, then joins the workers
+		~ThreadPool(void)
+		{
+			{
+				std::lock_guard<std::mutex> lock(Pools().mutex);
+				Pools().pools.erase(std::find(Pools().pools.begin(), Pools().pools.end(), this));
+			}
+			if( _forked )
+			{
+				// the workers only exist in the parent: their handles are left alone, not joined
+				new std::vector<std::thread>(std::move(_threads));
+				return;
+			}
+			{
+				std::lock_guard<std::mutex> lock(_sleepMutex);
+				_stop = true;
+			}
+			_wakeUp.notify_all();
+			for(std::thread& t : _threads) t.join();
+		}
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		// pool shared by the library, one thread per core
+		static ThreadPool& Instance(void)
+		{
+			// the logger's final flush, registered first, runs after the pool's workers are joined
+			Logger::Instance();
+			static ThreadPool pool;
+			return pool;
+		}
+
+		// index of the calling thread among the workers of the pool it belongs to, -1 for other threads
+		static int& CurrentWorker(void)
+		{
+			static thread_local int worker = -1;
+			return worker;
+		}
+
+		// true on the workers of this pool
+		bool IsWorker(void) const
+		{
+			return CurrentPool() == this;
+		}
+
+		// f(args...) on a worker; the future holds its result or exception
+		template<class F, class... Args>
+		auto Submit(F&& f, Args&&... args) -> std::future<decltype(f(args...))>
+		{
+			typedef decltype(f(args...)) R;
+			std::packaged_task<R()> task( std::bind(std::forward<F>(f), std::forward<Args>(args)...) );
+			std::future<R> future = task.get_future();
+			Push( Task(std::move(task)) );
+			return future;
+		}
+
+		// f() on a worker, without a future: exceptions are logged
+		template<class F>
+		void Post(F f)
+		{
+			Push( Task(std::move(f)) );
+		}
+
+		// returns once no task is queued or running, but the ones blocked in Wait; runs queued tasks meanwhile
+		void Wait(void)
+		{
+			int self = IsWorker() ? CurrentWorker() : -1;
+			std::size_t waiting = Depth() ? 1 : 0; // called from a task
+			_waiting.fetch_add(waiting);
+
+			Task task;
+			while( _unfinished.load() > _waiting.load() )
+			{
+				if( Pop(self, task) )
+				{
+					Execute(task);
+					continue;
+				}
+				std::uint64_t start = Clock();
+				{
+					std::unique_lock<std::mutex> lock(_sleepMutex);
+					_finished.wait_for(lock, std::chrono::milliseconds(1));
+				}
+				if( self >= 0 ) _queues[self]->blocked.fetch_add(Clock()-start, std::memory_order_relaxed);
+			}
+			_waiting.fetch_sub(waiting);
+		}
+
+		// runs queued tasks until done() is true; for waiting on a subset of the tasks
+		template<class Done>
+		void WaitUntil(Done done)
+		{
+			int self = IsWorker() ? CurrentWorker() : -1;
+			Task task;
+			unsigned int spins = 0;
+			while( !done() )
+			{
+				if( Pop(self, task) )
+				{
+					Execute(task);
+					spins = 0;
+					continue;
+				}
+				std::uint64_t start = Clock();
+				if( ++spins < 64 ) std::this_thread::yield();
+				else std::this_thread::sleep_for(std::chrono::microseconds(50));
+				if( self >= 0 ) _queues[self]->blocked.fetch_add(Clock()-start, std::memory_order_relaxed);
+			}
+		}
+
+		// nothing left in the calling worker's queue, or in any queue for other threads: the others went idle
+		// or stole everything, so work split now would be picked up
+		bool LocalQueueEmpty(void)
+		{
+			Worker* self = Self();
+			if( !self ) return _queued.load(std::memory_order_relaxed) == 0;
+			Lock(self->mutex, self);
+			std::lock_guard<std::mutex> lock(self->mutex, std::adopt_lock);
+			return self->tasks.empty();
+		}
+
+		// f(k) on every worker k, returning once all have run; rethrows the first exception
+		template<class F>
+		void RunOnEach(F f)
+		{
+			if( _forked )
+			{
+				for(std::size_t k=0; k<_queues.size(); k++) f(k);
+				return;
+			}
+
+			std::atomic<std::size_t> pending(_queues.size());
+			std::exception_ptr error;
+			std::mutex errorMutex;
+			for(std::size_t k=0; k<_queues.size(); k++)
+			{
+				_unfinished.fetch_add(1);
+				{
+					std::lock_guard<std::mutex> lock(_queues[k]->mutex);
+					_queues[k]->own.push_back( Task([&f, &pending, &error, &errorMutex, k]
+					{
+						try
+						{
+							f(k);
+						}
+						catch(...)
+						{
+							std::lock_guard<std::mutex> lock(errorMutex);
+							if( !error ) error = std::current_exception();
+						}
+						pending.fetch_sub(1, std::memory_order_release);
+					}) );
+					_queues[k]->owned.fetch_add(1);
+				}
+			}
+			{
+				// one task for each worker: all of them are woken up
+				std::lock_guard<std::mutex> lock(_sleepMutex);
+				_wakeUp.notify_all();
+			}
+			WaitUntil([&]{ return pending.load(std::memory_order_acquire) == 0; });
+
+			if( error ) std::rethrow_exception(error);
+		}
+
+		// zeroes data, each worker writing its share: with NUMA_NODES or CORES placement, the pages of a share
+		// are on the node of the worker that wrote them, for data later processed by the same split
+		void FirstTouch(void* data, std::size_t bytes)
+		{
+			std::size_t n = _queues.size();
+			RunOnEach([&](std::size_t k)
+			{
+				std::size_t begin = bytes*k/n, end = bytes*(k+1)/n;
+				std::memset(static_cast<char*>(data)+begin, 0, end-begin);
+			});
+		}
+
+		Placement GetPlacement(void) const
+		{
+			return _placement;
+		}
+
+		// NUMA node and CPU worker k is pinned to, -1 if it is not
+		int WorkerNode(unsigned int k) const
+		{
+			return _queues.at(k)->node;
+		}
+
+		int WorkerCpu(unsigned int k) const
+		{
+			return _queues.at(k)->cpu;
+		}
+
+		// false in a child process forked from the pool's
+		bool HasWorkers(void) const
+		{
+			return !_forked;
+		}
+
+		unsigned int Size(void) const
+		{
+			return _threads.size();
+		}
+
+		// tasks waiting for a worker
+		std::size_t Queued(void) const
+		{
+			return _queued.load(std::memory_order_relaxed);
+		}
+
+		// tasks queued or running
+		std::size_t Unfinished(void) const
+		{
+			return _unfinished.load(std::memory_order_relaxed);
+		}
+
+		// counters read one by one while workers run: a consistent snapshot only once the pool is idle
+		Statistics GetStatistics(void) const
+		{
+			Statistics stats;
+			stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _statisticsStart).count();
+			stats.queued = Queued();
+			stats.unfinished = Unfinished();
+			for(const std::unique_ptr<Worker>& w : _queues)
+			{
+				WorkerStatistics ws;
+				ws.tasks = w->executed.load(std::memory_order_relaxed);
+				ws.steals = w->stolen.load(std::memory_order_relaxed);
+				ws.busy = w->busy.load(std::memory_order_relaxed) * 1e-9;
+				std::uint64_t since = w->sleepingSince.load(std::memory_order_relaxed);
+				ws.idle = (w->idle.load(std::memory_order_relaxed) + (since ? Clock()-since : 0)) * 1e-9;
+				ws.blocked = w->blocked.load(std::memory_order_relaxed) * 1e-9;
+				stats.workers.push_back(ws);
+			}
+			return stats;
+		}
+
+		void ResetStatistics(void)
+		{
+			for(std::unique_ptr<Worker>& w : _queues)
+			{
+				w->executed.store(0, std::memory_order_relaxed);
+				w->stolen.store(0, std::memory_order_relaxed);
+				w->busy.store(0, std::memory_order_relaxed);
+				w->idle.store(0, std::memory_order_relaxed);
+				w->blocked.store(0, std::memory_order_relaxed);
+			}
+			_statisticsStart = std::chrono::steady_clock::now();
+		}
+
+		// one record per worker, then one for the pool
+		void LogStatistics(void) const
+		{
+			Statistics stats = GetStatistics();
+			for(std::size_t k=0; k<stats.workers.size(); k++)
+			{
+				const WorkerStatistics& w = stats.workers[k];
+				PLIB_LOG_INFO("pool worker").Field("worker", k).Field("cpu", _queues[k]->cpu)
+				.Field("tasks", w.tasks).Field("steals", w.steals)
+				.Field("busy_s", w.busy).Field("idle_s", w.idle).Field("blocked_s", w.blocked);
+			}
+			WorkerStatistics total = stats.Total();
+			PLIB_LOG_INFO("pool").Field("workers", stats.workers.size()).Field("seconds", stats.seconds)
+			.Field("queued", stats.queued).Field("unfinished", stats.unfinished)
+			.Field("tasks", total.tasks).Field("steals", total.steals)
+			.Field("utilization", stats.seconds > 0 ? total.busy / (stats.seconds * stats.workers.size()) : 0.0);
+		}
+
+	};
+
+	namespace detail
+	{
+		// lazy binary splitting: a range is halved only when the worker's queue is empty, that is when the halves
+		// it spawned before were stolen. Busy pools thus run ranges in large pieces, idle ones in small pieces
+		template<class Chunk>
+		struct SplitRange
+		{
+			std::size_t begin, end, grain;
+			Chunk* chunk;           // chunk(begin, end), at most grain wide
+			ThreadPool* pool;
+			std::atomic<std::size_t>* pending;
+			std::atomic<bool>* failed;
+			std::exception_ptr* error;
+			std::mutex* errorMutex;
+
+			void operator()(void)
+			{
+				try
+				{
+					while( begin < end && !failed->load(std::memory_order_relaxed) )
+					{
+						while( end-begin > grain && pool->LocalQueueEmpty() )
+						{
+							SplitRange upper = *this;
+							upper.begin = begin + (end-begin)/2;
+							end = upper.begin;
+							pending->fetch_add(1);
+							pool->Post(upper);
+						}
+						std::size_t stop = std::min(begin+grain, end);
+						(*chunk)(begin, stop);
+						begin = stop;
+					}
+				}
+				catch(...)
+				{
+					std::lock_guard<std::mutex> lock(*errorMutex);
+					if( !*error ) *error = std::current_exception();
+					failed->store(true);
+				}
+				pending->fetch_sub(1, std::memory_order_release);
+			}
+		};
+
+		// runs chunk over [begin, end) on the pool and the calling thread; rethrows the first exception
+		template<class Chunk>
+		void SplitAndRun(std::size_t begin, std::size_t end, std::size_t grain, Chunk chunk, ThreadPool& pool)
+		{
+			if( end <= begin ) return;
+			if( !grain ) grain = std::max<std::size_t>(1, (end-begin)/(64*pool.Size()));
+
+			// small ranges never touch the pool, nor do ranges in a forked child, where it has no worker
+			if( end-begin <= grain || !pool.HasWorkers() )
+			{
+				chunk(begin, end);
+				return;
+			}
+
+			std::atomic<std::size_t> pending(1);
+			std::atomic<bool> failed(false);
+			std::exception_ptr error;
+			std::mutex errorMutex;
+
+			SplitRange<Chunk> all = { begin, end, grain, &chunk, &pool, &pending, &failed, &error, &errorMutex };
+			all();
+			pool.WaitUntil([&]{ return pending.load(std::memory_order_acquire) == 0; });
+
+			if( error ) std::rethrow_exception(error);
+		}
+	}
+
+	// f(i) for every i in [begin, end), in chunks of grain indices spread over the pool's workers and the
+	// calling thread. grain = 0 picks one; ranges of at most grain indices run inline
+	template<class F>
+	void parallel_for(std::size_t begin, std::size_t end, std::size_t grain, F f, ThreadPool& pool = ThreadPool::Instance())
+	{
+		detail::SplitAndRun(begin, end, grain, [&f](std::size_t b, std::size_t e){ for(std::size_t i=b; i<e; i++) f(i); }, pool);
+	}
+
+	// op over f(i) for every i in [begin, end), starting from identity. Partial results are combined in
+	// no set order: op has to be associative and commutative, and floating point sums may differ between runs
+	template<class T, class F, class Op>
+	T parallel_reduce(std::size_t begin, std::size_t end, std::size_t grain, T identity, F f, Op op, ThreadPool& pool = ThreadPool::Instance())
+	{
+		T result = identity;
+		std::mutex mutex;
+		detail::SplitAndRun(begin, end, grain, [&](std::size_t b, std::size_t e)
+		{
+			T partial = identity;
+			for(std::size_t i=b; i<e; i++) partial = op(partial, f(i));
+			std::lock_guard<std::mutex> lock(mutex);
+			result = op(result, partial);
+		}, pool);
+		return result;
+	}
+
+	class Thread
+	{
+	private:
 
 		std::unique_ptr<std::thread> _thread;
+		std::future<void> _pooled; // strict mode, past the optimum
+
+		static std::atomic<unsigned int>& CurrentThreadsInUse(void)
+		{
+			static std::atomic<unsigned int> inUse(0);
+			return inUse;
+		}
+
+		static std::atomic<bool>& Strict(void)
+		{
+			static std::atomic<bool> strict(true);
+			return strict;
+		}
 
 	public:
-		Thread(std::Function fn)
+		// cpus restricts the thread to those CPUs; ignored when fn goes to the shared pool
+		Thread(std::function<void()> fn, std::vector<int> cpus = std::vector<int>())
 		{
-			if (!strict || !isMaxedOut())
+			if (!Strict() || !isMaxedOut())
 			{
-				//spawn
-				_thread = new std::thread(fn);
-				_currentThreadsInUse++;
+				//spawn; the count drops when fn returns, joined or detached
+				CurrentThreadsInUse()++;
+				_thread.reset( new std::thread([fn, cpus]{
+					struct Release { ~Release(void) { CurrentThreadsInUse()--; } } release;
+					if (!cpus.empty()) CpuTopology::PinCurrentThread(cpus);
+					fn();
+				}) );
 			}
-			else std::cerr << "Trying to use more threads than optimum allowed in strict mode. Thread not launched." << std::endl;
+			else _pooled = ThreadPool::Instance().Submit(fn);
 		}
 
+		~Thread(void)
+		{
+			if (_thread && _thread->joinable()) _thread->join();
+			if (_pooled.valid()) _pooled.wait();
+		}
+
+		Thread(const Thread&) = delete;
+		Thread& operator=(const Thread&) = delete;
+
+		// rethrows the exception of a task run on the pool
 		void Join(void){
 
-			_thread->join();
-			_currentThreadsInUse--;
+			if (_thread && _thread->joinable()) _thread->join();
+			if (_pooled.valid()) _pooled.get();
 
 		}
 
 		void Detach(void){
 
-			_thread->detach();
+			if (_thread && _thread->joinable()) _thread->detach();
 
 		}
 
-		void Pause(int time, string unit = "ms"){
+		static void Pause(int time, std::string unit = "ms"){
 
 			if (unit == "s") std::this_thread::sleep_for(std::chrono::seconds(time));
 			else if (unit == "ms") std::this_thread::sleep_for(std::chrono::milliseconds(time));
@@ -60,24 +887,30 @@ namespace p
 
 		}
 
+		static unsigned int OptimumMaxThreads(void)
+		{
+			static const unsigned int optimum = std::max(1u, std::thread::hardware_concurrency());
+			return optimum;
+		}
+
+		static unsigned int ThreadsInUse(void)
+		{
+			return CurrentThreadsInUse();
+		}
+
 		static void SetStrict(bool s)
 		{
-			if (!s || !isMaxedOut()) _strict = s;
-			else std::cerr << "There are already more than the optimum number of threads spawned. Cannot enforce strict mode" << std::endl;
+			if (!s || !isMaxedOut()) Strict() = s;
+			else PLIB_LOG_WARNING("more threads than the optimum already running, strict mode not enforced").Field("threads", ThreadsInUse());
 		}
 
 		static bool isMaxedOut(void)
 		{
-			return !(_currentThreadsInUse < _optimumMaxThreads - 1);
+			return !(CurrentThreadsInUse() + 1 < OptimumMaxThreads());
 		}
 
 	};
 
-	const unsigned short Thread::_optimumMaxThreads = std::thread::hardware_concurrency();
-	unsigned short Thread::_currentThreadsInUse = 0;
-	bool Thread::_strict = true;
-
-
 }
 
 #endif
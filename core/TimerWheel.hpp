@@ -0,0 +1,312 @@
+#ifndef __timerwheel__
+#define __timerwheel__
+
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+
+#include "Thread.hpp"
+
+/************************************* Plib timers ******************************************************
+Delayed and recurring callbacks, run on a ThreadPool; one timer thread per wheel, sleeping until the next one is due.
+
+p::TimerWheel& timers = p::TimerWheel::Instance();     // ticks of 1ms, callbacks on ThreadPool::Instance()
+p::TimerWheel::TimerId id = timers.After(std::chrono::seconds(5), []{ std::cout << "5s later"; });
+timers.Cancel(id);                                      // false if it already fired
+timers.Every(std::chrono::minutes(10), [&]{ net.Save("checkpoint.xml"); });
+
+p::TimerWheel coarse(pool, std::chrono::milliseconds(100)); // own thread, own pool, 100ms resolution
+
+Timers are kept in a hierarchical wheel: 4 levels of 64 slots, each slot a list of timers, so inserting
+and cancelling take constant time. A timer fires on the first tick at or after its due time, never early;
+recurring timers keep their rate, whatever the time their callback takes. Timers further than 64^4 ticks
+(4.6 hours at 1ms) wait in the last level and are placed again each time it turns.
+Callbacks run on the pool and must not block it for long; timers pending when the wheel is destroyed are dropped.
+***************************************************************************************************************/
+
+namespace p
+{
+
+	class TimerWheel
+	{
+
+	public:
+
+		typedef std::uint64_t TimerId; // 0 is never a valid id
+
+
+	private:
+
+		static const unsigned int SlotBits = 6;
+		static const unsigned int Slots = 1 << SlotBits;
+		static const unsigned int Levels = 4;
+		static const std::uint64_t Forever = ~std::uint64_t(0);
+
+		struct Timer
+		{
+			std::function<void()> callback;
+			std::uint64_t expiry;     // tick
+			std::uint64_t period;     // ticks, 0 for one-shot timers
+			std::uint32_t generation; // tells apart the timers successively stored here
+			int previous, next;       // in the slot's list, or the free list
+			int slot;                 // -1 when not in the wheel
+		};
+
+		ThreadPool& _pool;
+		const std::chrono::steady_clock::duration _tick;
+		const std::chrono::steady_clock::time_point _start;
+
+		std::vector<Timer> _timers;
+		int _free;                                // first free timer, -1 if none
+		int _slots[Levels*Slots];                 // first timer of each slot, -1 if empty
+		std::uint64_t _occupied[Levels];          // bit s set if slot s of the level has timers
+		std::size_t _size;
+		std::uint64_t _now;                       // every timer due up to this tick has been posted
+		std::uint64_t _wakeAt;                    // tick the timer thread sleeps until
+
+		std::mutex _mutex;
+		std::condition_variable _changed;
+		bool _stop;
+		std::thread _thread;
+
+		std::uint64_t CurrentTick(void) const
+		{
+			return (std::chrono::steady_clock::now() - _start) / _tick;
+		}
+
+		void Link(int t, int slot)
+		{
+			Timer& timer = _timers[t];
+			timer.slot = slot;
+			timer.previous = -1;
+			timer.next = _slots[slot];
+			if( timer.next >= 0 ) _timers[timer.next].previous = t;
+			_slots[slot] = t;
+			_occupied[slot / Slots] |= std::uint64_t(1) << (slot % Slots);
+		}
+
+		void Unlink(int t)
+		{
+			Timer& timer = _timers[t];
+			if( timer.previous >= 0 ) _timers[timer.previous].next = timer.next;
+			else _slots[timer.slot] = timer.next;
+			if( timer.next >= 0 ) _timers[timer.next].previous = timer.previous;
+			if( _slots[timer.slot] < 0 ) _occupied[timer.slot / Slots] &= ~(std::uint64_t(1) << (timer.slot % Slots));
+			timer.slot = -1;
+		}
+
+		// the lowest level whose slots are as wide as the time left: due within 64 ticks in level 0, etc.
+		void Place(int t)
+		{
+			Timer& timer = _timers[t];
+			if( timer.expiry <= _now ) timer.expiry = _now+1;
+			std::uint64_t delta = timer.expiry - _now;
+
+			for(unsigned int level=0; level<Levels; level++)
+				if( delta < std::uint64_t(1) << (SlotBits*(level+1)) )
+				{
+					Link(t, level*Slots + ((timer.expiry >> (SlotBits*level)) % Slots));
+					return;
+				}
+			// further than the wheel: in the last level's slot turned last, placed again from there
+			Link(t, (Levels-1)*Slots + (((_now >> (SlotBits*(Levels-1))) + Slots-1) % Slots));
+		}
+
+		void Free(int t)
+		{
+			Timer& timer = _timers[t];
+			timer.callback = nullptr;
+			timer.generation++;
+			timer.next = _free;
+			_free = t;
+			_size--;
+		}
+
+		// moves the timers of a higher level slot down, now that it is due
+		void Cascade(unsigned int level)
+		{
+			int slot = level*Slots + ((_now >> (SlotBits*level)) % Slots);
+			int t = _slots[slot];
+			while( t >= 0 )
+			{
+				int next = _timers[t].next;
+				Unlink(t);
+				Place(t);
+				t = next;
+			}
+		}
+
+		// tick of the next level 0 slot with timers, or of the next cascade, whichever comes first
+		std::uint64_t NextEvent(void) const
+		{
+			if( !_size ) return Forever;
+			std::uint64_t tick = _now+1;
+			for( ; tick % Slots; tick++)
+				if( _occupied[0] & (std::uint64_t(1) << (tick % Slots)) ) return tick;
+			return tick;
+		}
+
+		// posts the timers due up to 'tick', skipping the ticks without any
+		void Advance(std::uint64_t tick)
+		{
+			while( _now < tick )
+			{
+				std::uint64_t next = NextEvent();
+				if( next > tick ) { _now = tick; return; }
+				_now = next;
+
+				for(unsigned int level=1; level<Levels; level++)
+				{
+					if( (_now >> (SlotBits*(level-1))) % Slots ) break;
+					Cascade(level);
+				}
+
+				int slot = _now % Slots;
+				while( _slots[slot] >= 0 )
+				{
+					int t = _slots[slot];
+					Timer& timer = _timers[t];
+					Unlink(t);
+					if( timer.period )
+					{
+						_pool.Post(timer.callback);
+						timer.expiry += timer.period;
+						Place(t);
+					}
+					else
+					{
+						_pool.Post(std::move(timer.callback));
+						Free(t);
+					}
+				}
+			}
+		}
+
+		void Run(void)
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			while( !_stop )
+			{
+				Advance(CurrentTick());
+				_wakeAt = NextEvent();
+				if( _wakeAt == Forever ) _changed.wait(lock);
+				else _changed.wait_until(lock, _start + _wakeAt*_tick);
+			}
+		}
+
+		TimerId Schedule(std::chrono::steady_clock::duration delay, std::chrono::steady_clock::duration period, std::function<void()> callback)
+		{
+			// first tick starting at or after the due time: never early
+			std::chrono::steady_clock::duration due = std::chrono::steady_clock::now() - _start + std::max(delay, std::chrono::steady_clock::duration::zero());
+			std::uint64_t expiry = (due + _tick - std::chrono::steady_clock::duration(1)) / _tick;
+			std::uint64_t every = period.count() > 0 ? std::max<std::uint64_t>(1, (period + _tick/2) / _tick) : 0;
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			Advance(CurrentTick());
+
+			if( _free < 0 )
+			{
+				_timers.push_back(Timer());
+				_timers.back().generation = 1;
+				_timers.back().next = -1;
+				_timers.back().slot = -1;
+				_free = _timers.size()-1;
+			}
+			int t = _free;
+			Timer& timer = _timers[t];
+			_free = timer.next;
+			_size++;
+
+			timer.callback = std::move(callback);
+			timer.expiry = expiry;
+			timer.period = every;
+			Place(t);
+
+			if( timer.expiry < _wakeAt ) _changed.notify_one();
+			return (TimerId(timer.generation) << 32) | std::uint32_t(t);
+		}
+
+
+	public:
+
+		TimerWheel(ThreadPool& pool = ThreadPool::Instance(), std::chrono::steady_clock::duration tick = std::chrono::milliseconds(1))
+		:_pool(pool), _tick(std::max(tick, std::chrono::steady_clock::duration(1))), _start(std::chrono::steady_clock::now()),
+		_free(-1), _size(0), _now(0), _wakeAt(Forever), _stop(false)
+		{
+			for(int& s : _slots) s = -1;
+			for(std::uint64_t& o : _occupied) o = 0;
+			_thread = std::thread([this]{ Run(); });
+		}
+
+		~TimerWheel(void)
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stop = true;
+			}
+			_changed.notify_one();
+			_thread.join();
+		}
+
+		TimerWheel(const TimerWheel&) = delete;
+		TimerWheel& operator=(const TimerWheel&) = delete;
+
+		static TimerWheel& Instance(void)
+		{
+			static TimerWheel wheel;
+			return wheel;
+		}
+
+		// callback() once, 'delay' from now
+		template<class Rep, class Period>
+		TimerId After(std::chrono::duration<Rep,Period> delay, std::function<void()> callback)
+		{
+			return Schedule(std::chrono::duration_cast<std::chrono::steady_clock::duration>(delay), std::chrono::steady_clock::duration::zero(), std::move(callback));
+		}
+
+		// callback() every 'period', the first time 'period' from now unless 'delay' says otherwise
+		template<class Rep, class Period>
+		TimerId Every(std::chrono::duration<Rep,Period> period, std::function<void()> callback)
+		{
+			return Every(period, std::move(callback), period);
+		}
+
+		template<class Rep, class Period, class Rep2, class Period2>
+		TimerId Every(std::chrono::duration<Rep,Period> period, std::function<void()> callback, std::chrono::duration<Rep2,Period2> delay)
+		{
+			std::chrono::steady_clock::duration p = std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+			return Schedule(std::chrono::duration_cast<std::chrono::steady_clock::duration>(delay), std::max(p, std::chrono::steady_clock::duration(1)), std::move(callback));
+		}
+
+		// true if the timer was pending: it will not fire anymore. Callbacks already posted still run.
+		bool Cancel(TimerId id)
+		{
+			std::uint32_t t = id & 0xffffffff, generation = id >> 32;
+			std::lock_guard<std::mutex> lock(_mutex);
+			if( t >= _timers.size() || _timers[t].generation != generation || _timers[t].slot < 0 ) return false;
+			Unlink(t);
+			Free(t);
+			return true;
+		}
+
+		// pending timers
+		std::size_t Size(void)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _size;
+		}
+
+		std::chrono::steady_clock::duration Tick(void) const
+		{
+			return _tick;
+		}
+
+	};
+
+}
+
+#endif
@@ -8,7 +8,13 @@ int main(int argc, char** argv)
 	int					 input = parser.addOption<int>("-i", -17, "test int");
 	std::string			 allo  = parser.addOption<std::string>("-s", "coucou", "test string");
 	std::string			 peep  = parser.addOption<std::string>("-p", "salut");
-	std::cout << allo << std::endl << input << std::endl << peep << std::endl;
+	bool				 verbose = parser.addOption<bool>("-v", false, "verbose");
+	std::vector<std::string_view> includes = parser.addRepeatedOption<std::string_view>("-I", "include directory");
+	parser.CompileHelpFromOptions();
+
+	std::cout << allo << std::endl << input << std::endl << peep << std::endl << verbose << std::endl;
+	for (std::string_view include : includes) std::cout << "include " << include << std::endl;
+	for (std::string_view file : parser.Positional()) std::cout << "file " << file << std::endl;
 
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,54 @@
+#include "ConfigurationLoader.hpp"
+
+using namespace std;
+using namespace p;
+
+struct Training
+{
+	int epochs = 10;
+	unsigned int batch = 32;
+	double rate = 0.01;
+	double momentum = 0;
+	bool verbose = false;
+	vector<string> augment;
+};
+
+// usage: Configuration_example [--config training.xml] [--epochs 5] [--optimizer.rate=0.1] [--verbose] ...
+// environment: TRAIN_EPOCHS, TRAIN_OPTIMIZER_RATE, TRAIN_AUGMENT=flip,crop, ...
+int main(int argc, char** argv)
+{
+	CommandLineParser parser(argc, argv);
+	string config = parser.addOption<string>("--config", "training.xml", "configuration file");
+
+	try
+	{
+		ConfigurationLayer file(config);
+		ConfigurationLoader().Load(config.c_str(), file);
+
+		const Training training = Configuration<Training>()
+			.Option("epochs", &Training::epochs, "passes over the data")
+			.Option("batch", &Training::batch, "samples per update")
+			.Option("optimizer.rate", &Training::rate, "learning rate")
+			.Option("optimizer.momentum", &Training::momentum, "momentum")
+			.Option("verbose", &Training::verbose)
+			.Option("augment", &Training::augment, "augmentations")
+			.Layer(file)
+			.Environment("TRAIN_")
+			.CommandLine(parser)
+			.Resolve();
+		parser.CompileHelpFromOptions();
+
+		cout<<"epochs "<< training.epochs <<", batch "<< training.batch
+		<<", rate "<< training.rate <<", momentum "<< training.momentum
+		<<", verbose "<< training.verbose <<", augment";
+		for(const string& a : training.augment) cout<<" "<< a;
+		cout<<endl;
+	}
+	catch(exception& e)
+	{
+		cerr<< e.what() <<endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
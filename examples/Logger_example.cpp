@@ -0,0 +1,41 @@
+/******************************************************************************
+
+Logging from threads that outlive main
+
+Logger_example [tasks]
+	tasks: records logged by pool workers, half of them while the pool is destroyed at exit (8)
+
+Pool workers log before anything else touched the logger, then exit after main returns: their buffers
+have to stay valid, and every record has to be written. Build with -fsanitize=address to check the former,
+count the "task done" lines for the latter.
+
+/******************************************************************************/
+
+#include "../core/Thread.hpp"
+#include <cstdlib>
+
+using namespace std;
+using namespace p;
+
+int main( int argc, char** argv)
+{
+	int tasks = argc>1 ? atoi(argv[1]) : 8;
+
+	// the first log lines of the program, from workers
+	for(int i=0; i<tasks/2; i++)
+		ThreadPool::Instance().Post([i]{ PLIB_LOG_INFO("task done").Field("task", i); });
+	ThreadPool::Instance().Wait();
+
+	// short lived threads, their buffers retired then reused
+	for(int i=0; i<4; i++)
+	{
+		Thread t([i]{ PLIB_LOG_INFO("thread done").Field("thread", i); });
+		t.Join();
+	}
+
+	// still queued when main returns: run by the pool's destructor, before the logger's final flush
+	for(int i=tasks/2; i<tasks; i++)
+		ThreadPool::Instance().Post([i]{ this_thread::sleep_for(chrono::milliseconds(10)); PLIB_LOG_INFO("task done").Field("task", i); });
+
+	return EXIT_SUCCESS;
+}
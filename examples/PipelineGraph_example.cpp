@@ -0,0 +1,59 @@
+#include "PipelineLoader.hpp"
+
+using namespace std;
+using namespace p;
+
+
+class Constant : public Pipeline<double,double>
+{
+	private:
+		double _value;
+		double Execute(vector<double>::iterator, vector<double>::iterator)
+		{
+			return _value;
+		}
+	public:
+		Constant(string s, const PipelineParameters& parameters):Pipeline(s),_value(parameters.Get<double>("value"))
+		{}
+};
+
+class Scale : public Pipeline<double,double>
+{
+	private:
+		double _factor;
+		double Execute(vector<double>::iterator begin, vector<double>::iterator end)
+		{
+			double out=0;
+			while(begin < end) {out+=(*begin)*_factor;begin++;}
+			return out;
+		}
+	public:
+		Scale(string s, const PipelineParameters& parameters):Pipeline(s),_factor(parameters.Get<double>("factor", 1.0))
+		{}
+};
+
+PLIB_REGISTER_STAGE(Constant);
+PLIB_REGISTER_STAGE(Scale);
+
+// usage: PipelineGraph_example pipeline.xml
+int main(int argc, char** argv)
+{
+	PipelineLoader loader;
+	for( int i=1; i<argc; i++)
+	{
+		PipelineGraph graph;
+		try
+		{
+			loader.Load(argv[i], graph);
+			graph.Update();
+			cout<< graph.GetSink() <<endl;
+		}
+		catch(exception& e)
+		{
+			cerr<< e.what() <<endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,327 @@
+/******************************************************************************
+
+Pipeline benchmark on synthetic DAGs
+
+Pipeline_benchmark [nodes] [cost] [payload] [threads]
+	nodes:   size of the generated graphs (100000)
+	cost:    microseconds spent by each node of the scaling graphs (200)
+	payload: doubles produced by each node of the memory graphs (131072, 1MB)
+	threads: highest thread count of the scaling runs (one per core)
+
+The last section checks that data parallel stages running side by side still split their work over threads.
+
+Build with -O2 -fopenmp to run nodes concurrently.
+Node costs are spins until a wall clock time: past one thread per core, speedups are overstated.
+
+/******************************************************************************/
+
+#include "../core/Pipeline.hpp"
+#include "../core/DataParallel.hpp"
+#include <chrono>
+#include <set>
+#include <random>
+#include <thread>
+#include <cstdlib>
+#include <cmath>
+
+using namespace std;
+using namespace p;
+
+typedef vector<double> Payload;
+
+// spins for 'cost' microseconds, then outputs 'payload' doubles holding the sum of the inputs' first ones
+class Node : public Pipeline<Payload,Payload>
+{
+	private:
+		double _cost;
+		size_t _payload;
+		Payload Execute(vector<Payload>::iterator begin, vector<Payload>::iterator end)
+		{
+			chrono::steady_clock::time_point stop = chrono::steady_clock::now() + chrono::nanoseconds((long long)(_cost*1000));
+			while(chrono::steady_clock::now() < stop);
+
+			double sum=1;
+			while(begin < end) {if(!begin->empty()) sum+=begin->front();begin++;}
+			return Payload(_payload, sum);
+		}
+	public:
+		Node(string s, double cost=0, size_t payload=0):Pipeline(s),_cost(cost),_payload(payload){}
+};
+
+typedef vector<Node*> Graph;
+
+// every generated node gets the same cost, in microseconds, and payload, in doubles
+struct Shape
+{
+	double cost;
+	size_t payload;
+};
+
+// n nodes, node i feeds node i+1; the sink is the last node
+Graph Chain(size_t n, Shape s = Shape{0,0})
+{
+	Graph g;
+	for(size_t i=0; i<n; i++)
+	{
+		g.push_back(new Node("chain "+to_string(i), s.cost, s.payload));
+		if(i) g[i]->SetInput(g[i-1]);
+	}
+	return g;
+}
+
+// a source feeding 'width' independent nodes, all gathered by the sink
+Graph FanOut(size_t width, Shape s = Shape{0,0})
+{
+	Graph g(1, new Node("source", s.cost, s.payload));
+	Node* sink = new Node("sink", s.cost, s.payload);
+	for(size_t i=0; i<width; i++)
+	{
+		g.push_back(new Node("branch "+to_string(i), s.cost, s.payload));
+		g.back()->SetInput(g[0]);
+		sink->SetInput(g.back());
+	}
+	g.push_back(sink);
+	return g;
+}
+
+// 'levels' diamonds in a row: each join node fans out to 'width' nodes gathered by the next join
+Graph Diamonds(size_t levels, size_t width, Shape s = Shape{0,0})
+{
+	Graph g(1, new Node("join 0", s.cost, s.payload));
+	for(size_t l=1; l<=levels; l++)
+	{
+		Node* join = new Node("join "+to_string(l), s.cost, s.payload);
+		Node* previous = g.back();
+		for(size_t i=0; i<width; i++)
+		{
+			g.push_back(new Node("diamond "+to_string(l)+" "+to_string(i), s.cost, s.payload));
+			g.back()->SetInput(previous);
+			join->SetInput(g.back());
+		}
+		g.push_back(join);
+	}
+	return g;
+}
+
+// n nodes, each fed by up to 'degree' random nodes among the 'window' previous ones (0: any earlier node);
+// every node without consumer feeds the sink.
+// costs are skewed: most nodes are cheap, a few cost up to maxCost microseconds
+Graph RandomDAG(size_t n, size_t degree, size_t window=0, double maxCost=0, unsigned int seed=42, size_t payload=0)
+{
+	Graph g;
+	vector<bool> consumed(n,false);
+	mt19937 rng(seed);
+	uniform_real_distribution<double> u(0,1);
+
+	for(size_t i=0; i<n; i++)
+	{
+		g.push_back(new Node("random "+to_string(i), maxCost*pow(u(rng),4), payload));
+		for(size_t d=0; i && d<degree; d++)
+		{
+			size_t first = (window && i>window) ? i-window : 0;
+			size_t input = uniform_int_distribution<size_t>(first,i-1)(rng);
+			g[i]->SetInput(g[input]);
+			consumed[input]=true;
+		}
+	}
+
+	Node* sink = new Node("sink");
+	for(size_t i=0; i<n; i++)
+		if(!consumed[i]) sink->SetInput(g[i]);
+	g.push_back(sink);
+
+	return g;
+}
+
+void Clear(Graph& g)
+{
+	for(Node* n : g) delete n;
+	g.clear();
+}
+
+template<class F>
+double Milliseconds(F f)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	f();
+	return chrono::duration<double, milli>(chrono::steady_clock::now()-start).count();
+}
+
+// average time of a full update, once costs are known to the executor
+double Makespan(Graph& g, PipelineExecutor& executor, int runs=5)
+{
+	PipelineNode* sink = g.back();
+	for(Node* n : g) n->Invalidate();
+	executor.Run(sink); // warm up cost estimates
+
+	double total = 0;
+	for(int r=0; r<runs; r++)
+	{
+		for(Node* n : g) n->Invalidate();
+		total += Milliseconds([&]{ executor.Run(sink); });
+	}
+	return total/runs;
+}
+
+void BenchmarkValidation(string name, Graph g)
+{
+	PipelineNode* sink = g.back();
+	double cold = Milliseconds([&]{ sink->ValidateDAG(); });
+	double cached = Milliseconds([&]{ for(int i=0; i<1000; i++) sink->ValidateDAG(); }) / 1000;
+
+	cout<< name <<"\t"<< sink->Topology().size() <<" nodes"
+	<<"\tvalidation: "<< cold <<" ms"
+	<<"\tcached: "<< cached*1000 <<" us"
+	<<endl;
+}
+
+// nodes doing no work: everything measured is the executor's own cost
+void BenchmarkOverhead(string name, Graph g, unsigned int threads)
+{
+	PipelineExecutor executor(PipelineExecutor::CRITICAL_PATH, threads);
+	double ms = Makespan(g, executor, 3);
+
+	cout<< name <<"\t"<< g.size() <<" nodes\t"<< threads <<" threads"
+	<<"\toverhead: "<< ms*1000/g.size() <<" us/node"
+	<<"\tthroughput: "<< g.size()/ms <<" nodes/ms"
+	<<endl;
+}
+
+void BenchmarkScheduling(string name, Graph g, unsigned int threads)
+{
+	PipelineExecutor fifo(PipelineExecutor::FIFO, threads);
+	PipelineExecutor criticalPath(PipelineExecutor::CRITICAL_PATH, threads);
+
+	cout<< name <<"\t"<< g.size() <<" nodes\t"<< threads <<" threads"
+	<<"\tFIFO: "<< Makespan(g, fifo) <<" ms"
+	<<"\tcritical path: "<< Makespan(g, criticalPath) <<" ms"
+	<<endl;
+}
+
+// makespan from 1 to maxThreads threads, doubling; speedup against one thread
+void BenchmarkScaling(string name, Graph g, unsigned int maxThreads)
+{
+	cout<< name <<"\t"<< g.size() <<" nodes";
+	double single = 0;
+	for(unsigned int threads=1; threads<=maxThreads; threads = threads<maxThreads && threads*2>maxThreads ? maxThreads : threads*2)
+	{
+		PipelineExecutor executor(PipelineExecutor::CRITICAL_PATH, threads);
+		double ms = Makespan(g, executor, 3);
+		if(threads == 1) single = ms;
+		cout<<"\t"<< threads <<": "<< ms <<" ms (x"<< single/ms <<")";
+	}
+	cout<<endl;
+}
+
+// peak bytes of live outputs, keeping every output or releasing intermediates, without and with a budget
+void BenchmarkMemory(string name, Graph g, size_t payloadBytes)
+{
+	PipelineExecutor executor(PipelineExecutor::CRITICAL_PATH, 1);
+	auto peak = [&]{ Makespan(g, executor, 1); return executor.PeakBytes()/1048576.0; };
+
+	double all = peak();
+	executor.ReleaseIntermediates(true);
+	double released = peak();
+	executor.SetMemoryBudget(4*payloadBytes);
+	double budget = peak();
+
+	cout<< name <<"\t"<< g.size() <<" nodes"
+	<<"\tkeep all: "<< all <<" MB"
+	<<"\trelease: "<< released <<" MB"
+	<<"\tbudget "<< 4*payloadBytes/1048576.0 <<" MB: "<< budget <<" MB"
+	<<endl;
+}
+
+// two Maps running concurrently in a 3 node DAG, joined: each should have its chunks run by several threads
+void CheckStageParallelism(unsigned int threads)
+{
+	vector<int> numbers(1<<14);
+	for(size_t i=0; i<numbers.size(); i++) numbers[i] = i;
+
+	mutex m;
+	set<thread::id> seen[2];
+	auto square = [&](int map){
+		return [&, map](const int& i){
+			chrono::steady_clock::time_point stop = chrono::steady_clock::now() + chrono::microseconds(2);
+			while(chrono::steady_clock::now() < stop);
+			if( i%256 == 0 ) { lock_guard<mutex> lock(m); seen[map].insert(this_thread::get_id()); }
+			return i*i;
+		};
+	};
+
+	Map<int,int> a("map a", square(0)), b("map b", square(1));
+	Join<int> join("join");
+	a.SetGrainSize(256);
+	b.SetGrainSize(256);
+	a.SetInput(numbers);
+	b.SetInput(numbers);
+	join.SetInput(&a)->SetInput(&b);
+
+	PipelineExecutor executor(PipelineExecutor::CRITICAL_PATH, threads);
+	double ms = Milliseconds([&]{ executor.Run(&join); });
+
+	bool right = join.GetOutput().size() == 2*numbers.size() && join.GetOutput().back() == numbers.back()*numbers.back();
+	cout<<"2 Maps and a Join	"<< threads <<" threads	"<< ms <<" ms"
+	<<"	threads per Map: "<< seen[0].size() <<", "<< seen[1].size()
+	<< (seen[0].size() > 1 && seen[1].size() > 1 ? "" : "	SERIALIZED")
+	<< (right ? "" : "	WRONG RESULT") <<endl;
+}
+
+int main( int argc, char** argv)
+{
+	size_t n = argc>1 ? atoi(argv[1]) : 100000;
+	double cost = argc>2 ? atof(argv[2]) : 200;
+	size_t payload = argc>3 ? atoi(argv[3]) : 131072;
+	unsigned int maxThreads = argc>4 ? atoi(argv[4]) : max(1u, thread::hardware_concurrency());
+
+	cout<<"ValidateDAG"<<endl;
+
+	Graph g = Chain(n);
+	BenchmarkValidation("chain", g);
+	Clear(g);
+
+	g = RandomDAG(n, 4);
+	BenchmarkValidation("random", g);
+	Clear(g);
+
+	// scheduling and executor costs on zero cost nodes
+	cout<<endl<<"Overhead"<<endl;
+	size_t small = min<size_t>(n, 10000);
+	for(unsigned int threads : {1u, maxThreads})
+	{
+		g = Chain(small);                   BenchmarkOverhead("chain", g, threads);    Clear(g);
+		g = FanOut(small);                  BenchmarkOverhead("fan-out", g, threads);  Clear(g);
+		g = Diamonds(small/17, 16);         BenchmarkOverhead("diamonds", g, threads); Clear(g);
+		g = RandomDAG(small, 4);            BenchmarkOverhead("random", g, threads);   Clear(g);
+		if(maxThreads == 1) break;
+	}
+
+	// narrow window: long dependency chains of uneven cost, where ready order matters
+	cout<<endl<<"Scheduling"<<endl;
+	for(unsigned int seed=1; seed<=3; seed++)
+	{
+		g = RandomDAG(200, 1, 16, 2000, seed);
+		BenchmarkScheduling("random #"+to_string(seed), g, 4);
+		Clear(g);
+	}
+
+	cout<<endl<<"Scaling, "<< cost <<" us per node"<<endl;
+	Shape work = {cost, 0};
+	g = Chain(64, work);                        BenchmarkScaling("chain", g, maxThreads);    Clear(g);
+	g = FanOut(256, work);                      BenchmarkScaling("fan-out", g, maxThreads);  Clear(g);
+	g = Diamonds(16, 16, work);                 BenchmarkScaling("diamonds", g, maxThreads); Clear(g);
+	g = RandomDAG(256, 2, 32, 4*cost, 7);       BenchmarkScaling("random", g, maxThreads);   Clear(g);
+
+	cout<<endl<<"Peak memory, "<< payload*sizeof(double)/1048576.0 <<" MB per output"<<endl;
+	Shape data = {0, payload};
+	size_t bytes = payload*sizeof(double);
+	g = Chain(64, data);                        BenchmarkMemory("chain", g, bytes);    Clear(g);
+	g = FanOut(64, data);                       BenchmarkMemory("fan-out", g, bytes);  Clear(g);
+	g = Diamonds(8, 8, data);                   BenchmarkMemory("diamonds", g, bytes); Clear(g);
+	g = RandomDAG(64, 2, 8, 0, 7, payload);     BenchmarkMemory("random", g, bytes);   Clear(g);
+
+	cout<<endl<<"Data parallel stages in a DAG"<<endl;
+	CheckStageParallelism(max(2u, maxThreads));
+
+	return EXIT_SUCCESS;
+}
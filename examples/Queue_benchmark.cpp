@@ -0,0 +1,190 @@
+/******************************************************************************
+
+Queue benchmark: p::SPSCQueue and p::MPMCQueue against a mutex protected std::queue
+
+Queue_benchmark [items] [threads]
+	items:   values passed through each queue (10000000)
+	threads: highest number of producers, and of consumers (one per core, halved)
+
+Every run checks that each value came out exactly once.
+
+/******************************************************************************/
+
+#include "../core/Queue.hpp"
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+using namespace p;
+
+// mutex protected std::queue, bounded like the others
+class LockedQueue
+{
+	private:
+		mutex _mutex;
+		queue<size_t> _queue;
+		size_t _capacity;
+	public:
+		LockedQueue(size_t capacity):_capacity(capacity){}
+		bool TryPush(size_t v)
+		{
+			lock_guard<mutex> lock(_mutex);
+			if(_queue.size() >= _capacity) return false;
+			_queue.push(v);
+			return true;
+		}
+		bool TryPop(size_t& v)
+		{
+			lock_guard<mutex> lock(_mutex);
+			if(_queue.empty()) return false;
+			v = _queue.front();
+			_queue.pop();
+			return true;
+		}
+		size_t TryPushBatch(size_t* v, size_t n)
+		{
+			lock_guard<mutex> lock(_mutex);
+			n = min(n, _capacity-_queue.size());
+			for(size_t i=0; i<n; i++) _queue.push(v[i]);
+			return n;
+		}
+		size_t TryPopBatch(size_t* v, size_t n)
+		{
+			lock_guard<mutex> lock(_mutex);
+			n = min(n, _queue.size());
+			for(size_t i=0; i<n; i++) { v[i] = _queue.front(); _queue.pop(); }
+			return n;
+		}
+};
+
+double Seconds(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double>(chrono::steady_clock::now()-start).count();
+}
+
+void Spin(unsigned int& spins)
+{
+	if(++spins > 64) this_thread::yield();
+}
+
+// producers push 1..items between them, consumers pop until everything went through; batch = 0 for single values
+template<class Q>
+void Throughput(string name, Q& q, size_t items, unsigned int producers, unsigned int consumers, size_t batch = 0)
+{
+	atomic<size_t> popped(0), sum(0);
+	vector<thread> threads;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	for(unsigned int t=0; t<producers; t++)
+		threads.push_back(thread([&, t]{
+			size_t first = items*t/producers + 1, last = items*(t+1)/producers;
+			vector<size_t> values(max<size_t>(batch, 1));
+			unsigned int spins = 0;
+			for(size_t v=first; v<=last;)
+			{
+				if(!batch)
+				{
+					if(q.TryPush(v)) { v++; spins = 0; }
+					else Spin(spins);
+					continue;
+				}
+				size_t n = min(batch, last-v+1);
+				for(size_t i=0; i<n; i++) values[i] = v+i;
+				size_t pushed = 0;
+				while(pushed < n)
+				{
+					size_t k = q.TryPushBatch(&values[pushed], n-pushed);
+					pushed += k;
+					if(!k) Spin(spins);
+				}
+				v += n;
+			}
+		}));
+
+	for(unsigned int t=0; t<consumers; t++)
+		threads.push_back(thread([&]{
+			vector<size_t> values(max<size_t>(batch, 1));
+			size_t local = 0;
+			unsigned int spins = 0;
+			while(popped.load(memory_order_relaxed) < items)
+			{
+				size_t n = batch ? q.TryPopBatch(&values[0], batch) : q.TryPop(values[0]);
+				if(!n) { Spin(spins); continue; }
+				spins = 0;
+				for(size_t i=0; i<n; i++) local += values[i];
+				popped += n;
+			}
+			sum += local;
+		}));
+
+	for(thread& t : threads) t.join();
+	double s = Seconds(start);
+	bool ok = popped == items && sum == items*(items+1)/2;
+
+	cout<< name <<"\t"<< producers <<"P/"<< consumers <<"C"<< (batch ? "\tbatch "+to_string(batch) : "\t")
+	<<"\t"<< items/s/1e6 <<" M items/s"<< (ok ? "" : "\tWRONG RESULT") <<endl;
+}
+
+// round trip of one value between two threads, through a queue each way
+template<class Q>
+void Latency(string name, Q& ping, Q& pong, size_t rounds)
+{
+	thread echo([&]{
+		size_t v;
+		unsigned int spins = 0;
+		for(size_t r=0; r<rounds; r++)
+		{
+			while(!ping.TryPop(v)) Spin(spins);
+			while(!pong.TryPush(v)) Spin(spins);
+		}
+	});
+
+	vector<double> ns;
+	ns.reserve(rounds);
+	size_t v;
+	unsigned int spins = 0;
+	for(size_t r=0; r<rounds; r++)
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		while(!ping.TryPush(r)) Spin(spins);
+		while(!pong.TryPop(v)) Spin(spins);
+		ns.push_back(Seconds(start)*1e9);
+	}
+	echo.join();
+
+	sort(ns.begin(), ns.end());
+	cout<< name <<"\tround trip: median "<< ns[ns.size()/2] <<" ns\t99%: "<< ns[ns.size()*99/100] <<" ns"<<endl;
+}
+
+int main( int argc, char** argv)
+{
+	size_t items = argc>1 ? atoi(argv[1]) : 10000000;
+	unsigned int maxThreads = argc>2 ? atoi(argv[2]) : max(1u, thread::hardware_concurrency()/2);
+	const size_t capacity = 4096;
+
+	cout<<"Throughput"<<endl;
+	{ SPSCQueue<size_t> q(capacity); Throughput("SPSC", q, items, 1, 1); }
+	{ SPSCQueue<size_t> q(capacity); Throughput("SPSC", q, items, 1, 1, 64); }
+	for(unsigned int t=1; t<=maxThreads; t*=2)
+	{
+		{ MPMCQueue<size_t> q(capacity); Throughput("MPMC", q, items, t, t); }
+		{ MPMCQueue<size_t> q(capacity); Throughput("MPMC", q, items, t, t, 64); }
+		{ LockedQueue q(capacity);       Throughput("mutex", q, items, t, t); }
+		{ LockedQueue q(capacity);       Throughput("mutex", q, items, t, t, 64); }
+	}
+
+	cout<<endl<<"Latency"<<endl;
+	size_t rounds = min<size_t>(items/10, 100000);
+	{ SPSCQueue<size_t> a(capacity), b(capacity); Latency("SPSC", a, b, rounds); }
+	{ MPMCQueue<size_t> a(capacity), b(capacity); Latency("MPMC", a, b, rounds); }
+	{ LockedQueue a(capacity), b(capacity);       Latency("mutex", a, b, rounds); }
+
+	return EXIT_SUCCESS;
+}
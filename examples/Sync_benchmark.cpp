@@ -0,0 +1,177 @@
+/******************************************************************************
+
+Synchronization benchmark: p::Mutex, p::Barrier, p::Latch and p::SeqLock
+against their std counterparts, under contention
+
+Sync_benchmark [operations] [threads]
+	operations: lock acquisitions, or barrier phases / 100, per thread (1000000)
+	threads:    highest thread count (one per core)
+
+std::barrier and std::latch are only compared when built with -std=c++20.
+Every run checks its result.
+
+/******************************************************************************/
+
+#include "../core/Sync.hpp"
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <cstdlib>
+#if __cplusplus >= 202002L
+#include <barrier>
+#include <latch>
+#endif
+
+using namespace std;
+using namespace p;
+
+// runs f(t) on 'threads' threads, released together; seconds until all returned
+double Run(unsigned int threads, function<void(unsigned int)> f)
+{
+	atomic<bool> go(false);
+	vector<thread> pool;
+	for(unsigned int t=0; t<threads; t++)
+		pool.push_back(thread([&, t]{ while(!go) this_thread::yield(); f(t); }));
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	go = true;
+	for(thread& t : pool) t.join();
+	return chrono::duration<double>(chrono::steady_clock::now()-start).count();
+}
+
+void Report(string name, unsigned int threads, double operations, double seconds, bool ok)
+{
+	cout<< name <<"\t"<< threads <<" threads\t"<< operations/seconds/1e6 <<" M ops/s"<< (ok ? "" : "\tWRONG RESULT") <<endl;
+}
+
+// a shared counter incremented under the lock, with a little work outside it
+template<class M>
+void BenchmarkMutex(string name, unsigned int threads, size_t operations)
+{
+	M m;
+	size_t counter = 0;
+	double s = Run(threads, [&](unsigned int){
+		volatile size_t local = 0;
+		for(size_t i=0; i<operations; i++)
+		{
+			{ lock_guard<M> lock(m); counter++; }
+			for(int w=0; w<20; w++) local = local + w;
+		}
+	});
+	Report(name, threads, operations*threads, s, counter == operations*threads);
+}
+
+// 'phases' phases, each thread adds its index to the phase total; thread 0 checks it between two waits
+template<class B>
+void BenchmarkBarrier(string name, unsigned int threads, size_t phases, function<void(B&)> arrive)
+{
+	B barrier(threads);
+	atomic<size_t> total(0);
+	bool ok = true;
+	const size_t expected = threads*(threads-1)/2;
+	double s = Run(threads, [&](unsigned int t){
+		for(size_t p=0; p<phases; p++)
+		{
+			total += t;
+			arrive(barrier);
+			if( t == 0 )
+			{
+				if( total != expected ) ok = false;
+				total = 0;
+			}
+			arrive(barrier);
+		}
+	});
+	Report(name, threads, phases*2, s, ok);
+}
+
+// one latch per round, counted down by every thread
+template<class L>
+void BenchmarkLatch(string name, unsigned int threads, size_t rounds, function<void(L&)> arrive)
+{
+	vector<unique_ptr<L>> latches;
+	for(size_t r=0; r<rounds; r++) latches.emplace_back(new L(threads));
+	atomic<size_t> passed(0);
+	double s = Run(threads, [&](unsigned int){
+		for(size_t r=0; r<rounds; r++) { arrive(*latches[r]); passed++; }
+	});
+	Report(name, threads, rounds, s, passed == rounds*threads);
+}
+
+struct Pair
+{
+	size_t a, b;
+};
+
+// readers copy a pair the writer keeps equal; a torn read shows up as a != b
+template<class Read, class Write>
+void BenchmarkReaders(string name, unsigned int readers, size_t operations, Read read, Write write)
+{
+	atomic<bool> done(false), ok(true);
+	thread writer([&]{
+		for(size_t v=1; !done; v++) { write(Pair{v,v}); this_thread::yield(); }
+	});
+	double s = Run(readers, [&](unsigned int){
+		for(size_t i=0; i<operations; i++)
+		{
+			Pair p = read();
+			if( p.a != p.b ) ok = false;
+		}
+	});
+	done = true;
+	writer.join();
+	Report(name, readers, operations*readers, s, ok);
+}
+
+int main( int argc, char** argv)
+{
+	size_t operations = argc>1 ? atoi(argv[1]) : 1000000;
+	unsigned int maxThreads = argc>2 ? atoi(argv[2]) : max(1u, thread::hardware_concurrency());
+	size_t phases = max<size_t>(operations/100, 1);
+
+	vector<unsigned int> counts;
+	for(unsigned int t=1; t<=maxThreads; t = t<maxThreads && t*2>maxThreads ? maxThreads : t*2) counts.push_back(t);
+
+	cout<<"Mutex"<<endl;
+	for(unsigned int t : counts)
+	{
+		BenchmarkMutex<Mutex>("p::Mutex", t, operations);
+		BenchmarkMutex<mutex>("std::mutex", t, operations);
+	}
+
+	cout<<endl<<"Barrier"<<endl;
+	for(unsigned int t : counts)
+	{
+		BenchmarkBarrier<Barrier>("p::Barrier", t, phases, [](Barrier& b){ b.ArriveAndWait(); });
+		#if __cplusplus >= 202002L
+		BenchmarkBarrier< barrier<> >("std::barrier", t, phases, [](barrier<>& b){ b.arrive_and_wait(); });
+		#endif
+	}
+
+	cout<<endl<<"Latch"<<endl;
+	for(unsigned int t : counts)
+	{
+		BenchmarkLatch<Latch>("p::Latch", t, phases, [](Latch& l){ l.ArriveAndWait(); });
+		#if __cplusplus >= 202002L
+		BenchmarkLatch<latch>("std::latch", t, phases, [](latch& l){ l.arrive_and_wait(); });
+		#endif
+	}
+
+	cout<<endl<<"Readers, one writer"<<endl;
+	for(unsigned int t : counts)
+	{
+		SeqLock<Pair> seq;
+		BenchmarkReaders("p::SeqLock", t, operations, [&]{ return seq.Load(); }, [&](Pair p){ seq.Store(p); });
+		mutex m;
+		Pair shared = {0,0};
+		BenchmarkReaders("std::mutex", t, operations,
+			[&]{ lock_guard<mutex> lock(m); return shared; },
+			[&](Pair p){ lock_guard<mutex> lock(m); shared = p; });
+	}
+
+	return EXIT_SUCCESS;
+}
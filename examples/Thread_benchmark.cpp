@@ -0,0 +1,94 @@
+/******************************************************************************
+
+Thread benchmark: many tiny tasks on p::ThreadPool against a p::Thread per task
+
+Thread_benchmark [tasks] [threads]
+	tasks:   tasks run on the pool (1000000); p::Thread runs 1% of them, its cost being per task
+	threads: pool size (one per core)
+
+Build with -DPLIB_THREAD_STATS for the workers' busy, idle and blocked times.
+
+/******************************************************************************/
+
+#include "../core/Thread.hpp"
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <cstdlib>
+
+using namespace std;
+using namespace p;
+
+template<class F>
+double Milliseconds(F f)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	f();
+	return chrono::duration<double, milli>(chrono::steady_clock::now()-start).count();
+}
+
+void Report(string name, size_t tasks, double ms)
+{
+	cout<< name <<"\t"<< tasks <<" tasks\t"<< ms <<" ms\t"<< ms*1e6/tasks <<" ns/task" <<endl;
+}
+
+int main( int argc, char** argv)
+{
+	size_t tasks = argc>1 ? atoi(argv[1]) : 1000000;
+	unsigned int threads = argc>2 ? atoi(argv[2]) : 0;
+
+	ThreadPool pool(threads);
+	atomic<size_t> counter(0);
+	cout<<"pool of "<< pool.Size() <<" threads"<<endl;
+
+	Report("Post", tasks, Milliseconds([&]{
+		for(size_t i=0; i<tasks; i++) pool.Post([&]{ counter++; });
+		pool.Wait();
+	}));
+
+	Report("Submit", tasks, Milliseconds([&]{
+		vector< future<void> > futures;
+		futures.reserve(tasks);
+		for(size_t i=0; i<tasks; i++) futures.push_back( pool.Submit([&]{ counter++; }) );
+		for(future<void>& f : futures) f.get();
+	}));
+
+	// tasks spawning tasks land on their worker's own queue, others steal them
+	Report("nested Post", tasks, Milliseconds([&]{
+		size_t outer = 1000;
+		for(size_t i=0; i<outer; i++)
+			pool.Post([&]{ for(size_t j=0; j<tasks/outer; j++) pool.Post([&]{ counter++; }); });
+		pool.Wait();
+	}));
+
+	// where the workers' time went during the pool runs
+	ThreadPool::Statistics stats = pool.GetStatistics();
+	for(size_t k=0; k<stats.workers.size(); k++)
+	{
+		const ThreadPool::WorkerStatistics& w = stats.workers[k];
+		cout<<"worker "<< k <<"\t"<< w.tasks <<" tasks\t"<< w.steals <<" steals"
+		<<"\tbusy: "<< w.busy <<" s\tidle: "<< w.idle <<" s\tblocked: "<< w.blocked <<" s"<<endl;
+	}
+
+	// a thread created and joined per task: what p::Thread did for every task
+	Thread::SetStrict(false);
+	size_t few = max<size_t>(tasks/100, 1);
+	Report("p::Thread", few, Milliseconds([&]{
+		for(size_t i=0; i<few; i++)
+		{
+			Thread t([&]{ counter++; });
+			t.Join();
+		}
+	}));
+
+	Report("p::Thread x64", few, Milliseconds([&]{
+		for(size_t i=0; i<few; i+=64)
+		{
+			vector< unique_ptr<Thread> > batch;
+			for(size_t j=i; j<min(few, i+64); j++) batch.push_back( unique_ptr<Thread>(new Thread([&]{ counter++; })) );
+			for(unique_ptr<Thread>& t : batch) t->Join();
+		}
+	}));
+
+	return counter > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,117 @@
+/******************************************************************************
+
+Timer benchmark: p::TimerWheel against an ordered multimap of due times
+
+TimerWheel_benchmark [timers] [seconds]
+	timers:  timers scheduled then cancelled (1000000), and fired (timers/100)
+	seconds: longest delay of the fired timers (2)
+
+Inserting and cancelling are timed with delays far in the future, so that nothing fires meanwhile.
+Lateness is the time between a timer's due time and the start of its callback on the pool.
+
+/******************************************************************************/
+
+#include "../core/TimerWheel.hpp"
+#include <iostream>
+#include <map>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+using namespace p;
+
+// the usual alternative: due times kept sorted, O(log n) insert and cancel
+class OrderedTimers
+{
+	private:
+		mutex _mutex;
+		multimap<chrono::steady_clock::time_point, function<void()>> _timers;
+	public:
+		typedef multimap<chrono::steady_clock::time_point, function<void()>>::iterator TimerId;
+		TimerId After(chrono::steady_clock::duration delay, function<void()> f)
+		{
+			lock_guard<mutex> lock(_mutex);
+			return _timers.emplace(chrono::steady_clock::now()+delay, move(f));
+		}
+		bool Cancel(TimerId id)
+		{
+			lock_guard<mutex> lock(_mutex);
+			_timers.erase(id);
+			return true;
+		}
+};
+
+template<class F>
+double Milliseconds(F f)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	f();
+	return chrono::duration<double, milli>(chrono::steady_clock::now()-start).count();
+}
+
+template<class Timers>
+void BenchmarkInsertCancel(string name, Timers& timers, size_t n)
+{
+	mt19937 rng(1);
+	uniform_int_distribution<int> minutes(10, 600);
+	vector<typename Timers::TimerId> ids;
+	ids.reserve(n);
+
+	double insert = Milliseconds([&]{
+		for(size_t i=0; i<n; i++) ids.push_back(timers.After(chrono::minutes(minutes(rng)), []{}));
+	});
+	shuffle(ids.begin(), ids.end(), rng);
+	size_t cancelled = 0;
+	double cancel = Milliseconds([&]{
+		for(typename Timers::TimerId id : ids) cancelled += timers.Cancel(id);
+	});
+
+	cout<< name <<"\t"<< n <<" timers"
+	<<"\tinsert: "<< insert*1e6/n <<" ns"
+	<<"\tcancel: "<< cancel*1e6/n <<" ns"
+	<< (cancelled == n ? "" : "\tWRONG RESULT") <<endl;
+}
+
+void BenchmarkLateness(TimerWheel& timers, size_t n, double seconds)
+{
+	mt19937 rng(2);
+	uniform_int_distribution<long long> delay(0, (long long)(seconds*1e6));
+	vector<double> late(n);
+	atomic<size_t> fired(0), early(0);
+
+	for(size_t i=0; i<n; i++)
+	{
+		chrono::microseconds d(delay(rng));
+		chrono::steady_clock::time_point due = chrono::steady_clock::now() + d;
+		timers.After(d, [&, due, i]{
+			chrono::steady_clock::duration l = chrono::steady_clock::now() - due;
+			if( l.count() < 0 ) early++;
+			late[i] = chrono::duration<double, micro>(l).count();
+			fired++;
+		});
+	}
+	while( fired < n ) this_thread::sleep_for(chrono::milliseconds(10));
+
+	sort(late.begin(), late.end());
+	cout<<"TimerWheel\t"<< n <<" timers over "<< seconds <<" s"
+	<<"\tlate: median "<< late[n/2] <<" us"
+	<<"\t99%: "<< late[n*99/100] <<" us"
+	<<"\tmax: "<< late.back() <<" us"
+	<< (early ? "\tFIRED EARLY" : "") <<endl;
+}
+
+int main( int argc, char** argv)
+{
+	size_t n = argc>1 ? atoi(argv[1]) : 1000000;
+	double seconds = argc>2 ? atof(argv[2]) : 2;
+
+	cout<<"Insert and cancel"<<endl;
+	{ TimerWheel timers; BenchmarkInsertCancel("TimerWheel", timers, n); }
+	{ OrderedTimers timers; BenchmarkInsertCancel("multimap", timers, n); }
+
+	cout<<endl<<"Lateness, 1ms ticks"<<endl;
+	BenchmarkLateness(TimerWheel::Instance(), max<size_t>(n/100, 1), seconds);
+
+	return EXIT_SUCCESS;
+}
@@ -7,7 +7,7 @@ namespace NN
 {
 NNEntry::NNEntry(void)
 {
-	std::cout << "WARNING: creating empty NNEntry";
+	PLIB_LOG_WARNING("creating empty NNEntry");
 }
 
 NNEntry::NNEntry(p::Array<double> v, p::Array<double> tv) : _value(v), _targetValue(tv)
@@ -332,7 +332,7 @@ void NeuralNetwork::TrainNetwork(void)
 		//display progress
 
 		if (_epoch / floor(_maxEpochs / 10) == (int) (_epoch / floor(_maxEpochs / 10) ) )
-			std::cout << "\t" << (_epoch / floor(_maxEpochs / 10) ) * 10 << "% --- done" << std::endl;
+			PLIB_LOG_INFO("training").Field("done_percent", (_epoch / floor(_maxEpochs / 10) ) * 10).Field("epoch", _epoch);
 
 		_epoch++;
 	}
@@ -345,19 +345,15 @@ void NeuralNetwork::TrainNetwork(void)
 
 void NeuralNetwork::OutputTrainingResult(void)
 {
-	//Display results on console
+	//Log results
 	if (_verbose > 0)
 	{
-		std::cout << std::endl;
-		std::cout << "*********************************" << std::endl;
-		std::cout << "training set size : " << _trainingSet.size() << std::endl;
-		std::cout << "generalization set size : " << _generalizationSet.size() << std::endl << std::endl;
-		std::cout << "--> total : " << _generalizationSet.size() + _trainingSet.size() << std::endl << std::endl;
-		std::cout << "---------------------------------" << std::endl;
-		std::cout << "nb_epoch : " << _epoch << std::endl;
-		std::cout << "average accuracy : " << _generalizationAccuracy << std::endl;
-		std::cout << "error : " << _generalizationError << std::endl << std::endl;
-		std::cout << "*********************************" << std::endl;
+		PLIB_LOG_INFO("training done")
+		.Field("training_set", _trainingSet.size())
+		.Field("generalization_set", _generalizationSet.size())
+		.Field("epochs", _epoch)
+		.Field("accuracy", _generalizationAccuracy)
+		.Field("error", _generalizationError);
 	}
 
 	//Write results in file
@@ -431,15 +427,15 @@ void NeuralNetwork::FeedForward(const std::vector<double>& inputs)
 	for (unsigned int i = 1; i < _nbNodes.at(0); i++)
 		_neurons.at(0, i) = inputs[i - 1];
 
-	//feed each layer to the next (except output layer)
+	//feed each layer to the next (except output layer); nodes of a layer are independent, small layers run inline
 	for (unsigned int layer = 0; layer < _nbLayers - 1; layer++)
-		for (unsigned int nextNode = 1; nextNode < _nbNodes.at(layer + 1); nextNode++)
+		p::parallel_for(1, _nbNodes.at(layer + 1), 32, [&](unsigned int nextNode)
 		{
 			for (unsigned int node = 0; node < _nbNodes[layer]; node++)
 				_neurons.at(layer + 1, nextNode) += _neurons.at(layer, node) * _weight.at(layer, node, nextNode);
 
 			_neurons.at(layer + 1, nextNode) = ActivationFunction(_neurons.at(layer + 1, nextNode) );
-		}
+		});
 
 	//compensate the output's first node who does not have a bias
 	for (unsigned int node = 0; node < _nbNodes.at(_nbLayers - 2); node++)
@@ -467,21 +463,23 @@ void NeuralNetwork::Backpropagate(std::vector<double> expectedValues)
 
 	// Calculate error for each node
 	for (unsigned int layer = _nbLayers - 2; layer > 0; layer--)
-		for (unsigned int node = 0; node < _nbNodes.at(layer); node++)
+		p::parallel_for(0, _nbNodes.at(layer), 32, [&](unsigned int node)
 		{
 			double sum = 0.0f;
 			for (unsigned int nextNode = 0; nextNode < _nbNodes.at(layer + 1); nextNode++)
 				sum += dnode.at(layer + 1, nextNode) * _weight.at(layer, node, nextNode);
 			dnode.at(layer, node) = InverseActivationFunc(_neurons.at(layer, node) ) * sum;
-		}
+		});
 
 	//backpropagate
 
 	//std::cout<<"DweightHO ";
 	for (unsigned int layer = 0; layer < _nbLayers - 1; layer++)
-		for (unsigned int node = 0; node < _nbNodes.at(layer); node++)
+		p::parallel_for(0, _nbNodes.at(layer), 32, [&](unsigned int node)
+		{
 			for (unsigned int nextNode = 0; nextNode < _nbNodes.at(layer + 1); nextNode++)
 				_Dweight.at(layer, node, nextNode) = _neurons(layer, node) * dnode.at(layer, node);
+		});
 
 	UpdateWeights();
 }
@@ -36,6 +36,8 @@
 #include <algorithm> // needed for for_each
 
 #include "Array.hpp" // allow for p::Array input
+#include "Logger.hpp"
+#include "Thread.hpp" // parallel_for over the nodes of a layer
 
 
 namespace p
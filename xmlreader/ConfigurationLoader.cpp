@@ -0,0 +1,58 @@
+#include "ConfigurationLoader.hpp"
+
+
+p::ConfigurationLoader::ConfigurationLoader()
+{
+}
+p::ConfigurationLoader::~ConfigurationLoader()
+{
+}
+
+std::string p::ConfigurationLoader::Where(const TiXmlElement* pElement)
+{
+	return _source+":"+std::to_string(pElement->Row());
+}
+
+void p::ConfigurationLoader::Read(const TiXmlElement* pParent, const std::string& prefix, ConfigurationLayer& layer)
+{
+	for ( const TiXmlElement* pChild = pParent->FirstChildElement(); pChild; pChild = pChild->NextSiblingElement() )
+	{
+		std::string key = prefix+pChild->Value();
+		const char* value = pChild->Attribute("value");
+		const char* text = pChild->GetText();
+
+		if ( value && text )
+			throw ConfigurationException(Where(pChild)+": <"+key+"> has both a value attribute and text");
+		if ( (value || text) && pChild->FirstChildElement() )
+			throw ConfigurationException(Where(pChild)+": <"+key+"> has both a value and child elements");
+
+		if ( value ) layer.Add(key, value, Where(pChild));
+		else if ( text )
+		{
+			// <augment> flip </augment>
+			std::string s = text;
+			std::size_t first = s.find_first_not_of(" \t\r\n"), last = s.find_last_not_of(" \t\r\n");
+			layer.Add(key, first == std::string::npos ? "" : s.substr(first, last-first+1), Where(pChild));
+		}
+		else Read(pChild, key+".", layer);
+	}
+}
+
+void p::ConfigurationLoader::Load(const char* pFilename, ConfigurationLayer& layer)
+{
+	TiXmlDocument doc(pFilename);
+	_source = pFilename;
+	if ( !doc.LoadFile() )
+		throw ConfigurationException(_source+":"+std::to_string(doc.ErrorRow())+": "+doc.ErrorDesc());
+	if ( doc.RootElement() ) Read(doc.RootElement(), "", layer);
+}
+
+void p::ConfigurationLoader::Parse(const char* xml, ConfigurationLayer& layer)
+{
+	TiXmlDocument doc;
+	_source = "<string>";
+	doc.Parse(xml);
+	if ( doc.Error() )
+		throw ConfigurationException(_source+":"+std::to_string(doc.ErrorRow())+": "+doc.ErrorDesc());
+	if ( doc.RootElement() ) Read(doc.RootElement(), "", layer);
+}
@@ -0,0 +1,46 @@
+#ifndef CONFIGURATIONLOADER_HPP
+#define CONFIGURATIONLOADER_HPP
+
+#include "tinyxml.h"
+#include "../core/Configuration.hpp"
+
+/*
+Fills a p::ConfigurationLayer from an XML file, for p::Configuration.
+
+<training>
+	<epochs value="20"/>
+	<optimizer>
+		<rate value="0.05"/>
+	</optimizer>
+	<augment>flip</augment>
+	<augment>crop</augment>
+</training>
+
+Keys are the paths of the elements below the root, joined by dots: epochs=20, optimizer.rate=0.05.
+Values are in a value attribute, or the element's text; repeated elements make lists (augment=flip,crop).
+Elements with neither only group others. The root element's name does not matter.
+Errors are thrown as p::ConfigurationException, with the line of the faulty element.
+*/
+
+namespace p {
+class ConfigurationLoader {
+private:
+
+std::string _source;
+
+std::string Where(const TiXmlElement* pElement);
+void Read(const TiXmlElement* pParent, const std::string& prefix, ConfigurationLayer& layer);
+
+public:
+ConfigurationLoader();
+~ConfigurationLoader();
+
+void Load(const char* pFilename, ConfigurationLayer& layer);
+void Parse(const char* xml, ConfigurationLayer& layer);
+
+};
+}
+
+
+
+#endif
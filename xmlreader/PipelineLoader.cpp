@@ -0,0 +1,146 @@
+#include "PipelineLoader.hpp"
+
+
+p::PipelineLoader::PipelineLoader()
+{
+}
+p::PipelineLoader::~PipelineLoader()
+{
+}
+
+std::string p::PipelineLoader::Where(const TiXmlElement* pElement)
+{
+	return _source+":"+std::to_string(pElement->Row())+": <"+pElement->Value()+"> ";
+}
+
+std::string p::PipelineLoader::Attribute(const TiXmlElement* pElement, const char* name, bool required)
+{
+	const char* value = pElement->Attribute(name);
+	if ( !value && required ) throw PipelineGraphException(Where(pElement)+"missing attribute '"+name+"'");
+	return value ? value : "";
+}
+
+bool p::PipelineLoader::BoolAttribute(const TiXmlElement* pElement, const char* name, bool defaultValue)
+{
+	bool value = defaultValue;
+	if ( pElement->QueryBoolAttribute(name, &value) == TIXML_WRONG_TYPE )
+		throw PipelineGraphException(Where(pElement)+"attribute '"+name+"' has to be true or false");
+	return value;
+}
+
+void p::PipelineLoader::Build(const TiXmlDocument& doc, PipelineGraph& graph)
+{
+	const TiXmlElement* pRoot = doc.RootElement();
+	if ( !pRoot || std::string(pRoot->Value()) != "pipeline" )
+		throw PipelineGraphException(_source+": root element has to be <pipeline>");
+
+	// stages first, so that inputs may name stages defined further down
+	for ( const TiXmlElement* pStage = pRoot->FirstChildElement("stage"); pStage; pStage = pStage->NextSiblingElement("stage") )
+	{
+		std::string name = Attribute(pStage, "name");
+		PipelineParameters parameters;
+		for ( const TiXmlElement* pParam = pStage->FirstChildElement("param"); pParam; pParam = pParam->NextSiblingElement("param") )
+			parameters.Set( Attribute(pParam, "name"), Attribute(pParam, "value") );
+
+		try
+		{
+			PipelineNode* stage = graph.AddStage( Attribute(pStage, "type"), name, parameters );
+			stage->Pin( BoolAttribute(pStage, "pin", false) );
+
+			std::string group = Attribute(pStage, "group", false);
+			if ( !group.empty() ) graph.SetProcessGroup(name, group);
+
+			double deadline = 0;
+			if ( pStage->QueryDoubleAttribute("deadline", &deadline) == TIXML_WRONG_TYPE || deadline < 0 )
+				throw PipelineGraphException(Where(pStage)+"deadline has to be a positive number of milliseconds");
+			stage->SetDeadline( std::chrono::nanoseconds( (long long)(deadline*1e6) ) );
+		}
+		catch(const PipelineGraphException& e)
+		{
+			throw PipelineGraphException(Where(pStage)+e.what());
+		}
+	}
+
+	// inputs are connected in document order
+	for ( const TiXmlElement* pChild = pRoot->FirstChildElement(); pChild; pChild = pChild->NextSiblingElement() )
+	{
+		std::string element = pChild->Value();
+		std::vector< std::pair<const TiXmlElement*, std::string> > inputs; // element, consumer
+
+		if ( element == "stage" )
+		{
+			for ( const TiXmlElement* pInput = pChild->FirstChildElement(); pInput; pInput = pInput->NextSiblingElement() )
+			{
+				std::string child = pInput->Value();
+				if ( child == "input" ) inputs.push_back( std::make_pair(pInput, Attribute(pChild, "name")) );
+				else if ( child != "param" ) throw PipelineGraphException(Where(pInput)+"unexpected in <stage>");
+			}
+		}
+		else if ( element == "edge" ) inputs.push_back( std::make_pair(pChild, Attribute(pChild, "to")) );
+		else throw PipelineGraphException(Where(pChild)+"unexpected in <pipeline>");
+
+		for ( const std::pair<const TiXmlElement*, std::string>& input : inputs )
+		{
+			try
+			{
+				graph.Connect( Attribute(input.first, "from"), input.second );
+			}
+			catch(const std::exception& e)
+			{
+				throw PipelineGraphException(Where(input.first)+e.what());
+			}
+		}
+	}
+
+	// executor hints
+	int threads = 0;
+	if ( pRoot->QueryIntAttribute("threads", &threads) == TIXML_WRONG_TYPE || threads < 0 )
+		throw PipelineGraphException(Where(pRoot)+"threads has to be a positive integer");
+	graph.Executor().SetThreads(threads);
+
+	std::string policy = Attribute(pRoot, "policy", false);
+	if ( policy == "fifo" ) graph.Executor().SetPolicy(PipelineExecutor::FIFO);
+	else if ( policy.empty() || policy == "critical_path" ) graph.Executor().SetPolicy(PipelineExecutor::CRITICAL_PATH);
+	else throw PipelineGraphException(Where(pRoot)+"policy has to be fifo or critical_path");
+
+	graph.Executor().ReleaseIntermediates( BoolAttribute(pRoot, "release", false) );
+
+	std::string budget = Attribute(pRoot, "memoryBudget", false);
+	if ( !budget.empty() )
+	{
+		std::istringstream ss(budget);
+		std::size_t bytes;
+		if ( !(ss >> bytes) || !ss.eof() ) throw PipelineGraphException(Where(pRoot)+"memoryBudget has to be a number of bytes");
+		graph.Executor().SetMemoryBudget(bytes);
+	}
+
+	// validated once, here, rather than at every update
+	try
+	{
+		graph.SetSink( Attribute(pRoot, "sink") );
+		graph.Validate();
+	}
+	catch(const std::exception& e)
+	{
+		throw PipelineGraphException(Where(pRoot)+e.what());
+	}
+}
+
+void p::PipelineLoader::Load(const char* pFilename, PipelineGraph& graph)
+{
+	TiXmlDocument doc(pFilename);
+	_source = pFilename;
+	if ( !doc.LoadFile() )
+		throw PipelineGraphException(_source+":"+std::to_string(doc.ErrorRow())+": "+doc.ErrorDesc());
+	Build(doc, graph);
+}
+
+void p::PipelineLoader::Parse(const char* xml, PipelineGraph& graph)
+{
+	TiXmlDocument doc;
+	_source = "<string>";
+	doc.Parse(xml);
+	if ( doc.Error() )
+		throw PipelineGraphException(_source+":"+std::to_string(doc.ErrorRow())+": "+doc.ErrorDesc());
+	Build(doc, graph);
+}
@@ -0,0 +1,50 @@
+#ifndef PIPELINELOADER_HPP
+#define PIPELINELOADER_HPP
+
+#include "tinyxml.h"
+#include "../core/PipelineGraph.hpp"
+
+/*
+Fills a p::PipelineGraph from an XML description; stage types come from the graph's PipelineRegistry.
+
+<pipeline sink="total" threads="4" policy="critical_path" release="true" memoryBudget="536870912">
+	<stage name="numbers" type="Range">
+		<param name="count" value="1000"/>
+	</stage>
+	<stage name="total" type="Sum" pin="true" group="isolated" deadline="250">
+		<input from="numbers"/>
+	</stage>
+	<edge from="numbers" to="total"/>
+</pipeline>
+
+Inputs, from <input> or <edge>, are connected in document order, once every stage exists.
+threads, policy, release and memoryBudget configure the graph's executor (see PipelineExecutor.hpp);
+pin keeps a stage's output when intermediates are released, group runs stages in a child process,
+deadline fails the run if the stage runs for longer, in milliseconds.
+Errors are thrown as p::PipelineGraphException, with the line of the faulty element.
+*/
+
+namespace p {
+class PipelineLoader {
+private:
+
+std::string _source;
+
+std::string Where(const TiXmlElement* pElement);
+std::string Attribute(const TiXmlElement* pElement, const char* name, bool required = true);
+bool BoolAttribute(const TiXmlElement* pElement, const char* name, bool defaultValue);
+void Build(const TiXmlDocument& doc, PipelineGraph& graph);
+
+public:
+PipelineLoader();
+~PipelineLoader();
+
+void Load(const char* pFilename, PipelineGraph& graph);
+void Parse(const char* xml, PipelineGraph& graph);
+
+};
+}
+
+
+
+#endif